@@ -0,0 +1,164 @@
+#pragma once
+
+// ヒープ確保の回数, バイト数, 最大使用量を計測する (TRACK_ALLOCを定義したときだけ有効)
+// operator new/deleteを置き換えるので、翻訳単位が1つのプログラムでだけ使う
+// - TRACE_SCOPEの区間ごと (一番内側の区間に計上する)
+// - alloc_turn_begin() ~ alloc_turn_end(turn) で囲んだターンごと
+// に集計し、alloc_report()でALLOCFILE(default: alloc.txt)に書き出す
+#ifdef TRACK_ALLOC
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+
+#ifndef ALLOCFILE
+  #define ALLOCFILE "alloc.txt"
+#endif
+
+namespace AllocTracker {
+
+constexpr int max_phases = 64;
+constexpr int max_turns = 512;
+constexpr std::size_t header_size = alignof(std::max_align_t); // 確保したサイズを先頭に置く
+
+struct Counter {
+  std::atomic<long long> count{0}, bytes{0};
+};
+struct TurnStats {
+  int turn;
+  long long count, bytes, peak;
+};
+
+// 計測中にヒープを使わないように、すべて固定長
+const char *phase_names[max_phases] = { "(none)" };
+int phases_num = 1;
+std::mutex phase_mtx;
+Counter phase_counters[max_phases];
+Counter total;
+std::atomic<long long> live{0}, peak{0}, turn_peak{0};
+thread_local int current_phase = 0;
+
+TurnStats turns[max_turns];
+int turns_num = 0;
+long long turn_begin_count = 0, turn_begin_bytes = 0;
+
+inline void update_max(std::atomic<long long> &a, const long long v) noexcept{
+  long long cur = a.load(std::memory_order_relaxed);
+  while(cur < v && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed));
+}
+inline void on_alloc(const std::size_t n) noexcept{
+  total.count.fetch_add(1, std::memory_order_relaxed);
+  total.bytes.fetch_add(n, std::memory_order_relaxed);
+  phase_counters[current_phase].count.fetch_add(1, std::memory_order_relaxed);
+  phase_counters[current_phase].bytes.fetch_add(n, std::memory_order_relaxed);
+  const long long now = live.fetch_add(n, std::memory_order_relaxed) + n;
+  update_max(peak, now);
+  update_max(turn_peak, now);
+}
+inline void on_free(const std::size_t n) noexcept{
+  live.fetch_sub(n, std::memory_order_relaxed);
+}
+
+// インライン展開されるとGCCがnew/deleteの組の不一致を誤検出するので、展開させない
+[[gnu::noinline]] inline void *allocate(const std::size_t n) noexcept{
+  char *p = (char*)std::malloc(n + header_size);
+  if(!p) return nullptr;
+  std::memcpy(p, &n, sizeof(n));
+  on_alloc(n);
+  return p + header_size;
+}
+[[gnu::noinline]] inline void deallocate(void *ptr) noexcept{
+  if(!ptr) return;
+  char *p = (char*)ptr - header_size;
+  std::size_t n;
+  std::memcpy(&n, p, sizeof(n));
+  on_free(n);
+  std::free(p);
+}
+
+// 区間の名前(文字列リテラル)の番号, 呼び出し箇所ごとに1度だけ呼ぶ
+inline int phase_id(const char *name){
+  std::lock_guard<std::mutex> lock(phase_mtx);
+  for(int i = 0; i < phases_num; i++){
+    if(!std::strcmp(phase_names[i], name)) return i;
+  }
+  if(phases_num == max_phases) return 0;
+  phase_names[phases_num] = name;
+  return phases_num++;
+}
+
+struct Phase {
+  explicit Phase(const int id) : prev(current_phase){ current_phase = id; }
+  ~Phase(){ close(); }
+  void close(){
+    if(prev < 0) return;
+    current_phase = prev;
+    prev = -1;
+  }
+  Phase(const Phase&) = delete;
+  Phase &operator=(const Phase&) = delete;
+
+private:
+  int prev;
+};
+
+} // namespace AllocTracker
+
+void *operator new(const std::size_t n){
+  if(void *p = AllocTracker::allocate(n)) return p;
+  throw std::bad_alloc();
+}
+void *operator new[](const std::size_t n){
+  if(void *p = AllocTracker::allocate(n)) return p;
+  throw std::bad_alloc();
+}
+void *operator new(const std::size_t n, const std::nothrow_t&) noexcept{ return AllocTracker::allocate(n); }
+void *operator new[](const std::size_t n, const std::nothrow_t&) noexcept{ return AllocTracker::allocate(n); }
+void operator delete(void *p) noexcept{ AllocTracker::deallocate(p); }
+void operator delete[](void *p) noexcept{ AllocTracker::deallocate(p); }
+void operator delete(void *p, std::size_t) noexcept{ AllocTracker::deallocate(p); }
+void operator delete[](void *p, std::size_t) noexcept{ AllocTracker::deallocate(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept{ AllocTracker::deallocate(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept{ AllocTracker::deallocate(p); }
+
+inline void alloc_turn_begin(){
+  AllocTracker::turn_begin_count = AllocTracker::total.count;
+  AllocTracker::turn_begin_bytes = AllocTracker::total.bytes;
+  AllocTracker::turn_peak = AllocTracker::live.load();
+}
+inline void alloc_turn_end(const int turn){
+  using namespace AllocTracker;
+  if(turns_num == max_turns) return;
+  turns[turns_num++] = { turn, total.count - turn_begin_count, total.bytes - turn_begin_bytes, turn_peak.load() };
+}
+inline void alloc_report(const char *path = ALLOCFILE){
+  using namespace AllocTracker;
+  std::FILE *fp = std::fopen(path, "w");
+  if(!fp) return;
+  std::fprintf(fp, "total: %lld allocs, %lld bytes, peak %lld bytes, live %lld bytes\n\n",
+               total.count.load(), total.bytes.load(), peak.load(), live.load());
+  std::fprintf(fp, "%-32s %12s %14s\n", "phase", "allocs", "bytes");
+  for(int i = 0; i < phases_num; i++){
+    std::fprintf(fp, "%-32s %12lld %14lld\n", phase_names[i], phase_counters[i].count.load(), phase_counters[i].bytes.load());
+  }
+  std::fprintf(fp, "\n%6s %12s %14s %14s\n", "turn", "allocs", "bytes", "peak");
+  for(int i = 0; i < turns_num; i++){
+    std::fprintf(fp, "%6d %12lld %14lld %14lld\n", turns[i].turn, turns[i].count, turns[i].bytes, turns[i].peak);
+  }
+  std::fclose(fp);
+}
+
+#define ALLOC_PHASE_VAR(var, name) \
+  AllocTracker::Phase var([]{ static const int id = AllocTracker::phase_id(name); return id; }())
+#define ALLOC_PHASE_CLOSE(var) var.close()
+
+#else
+inline void alloc_turn_begin(){}
+inline void alloc_turn_end(const int){}
+inline void alloc_report(const char * = nullptr){}
+#define ALLOC_PHASE_VAR(var, name) ((void)0)
+#define ALLOC_PHASE_CLOSE(var) ((void)0)
+#endif
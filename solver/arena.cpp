@@ -0,0 +1,246 @@
+// ヘッドレス自己対戦ツール
+// visualizer/App/field/*.csvの全盤面で2つのsolver設定を先攻/後攻を入れ替えて対戦させ、
+// 勝率, 点差, 1ターンあたりの思考時間を集計する
+//
+// usage: arena [-j jobs] [-n rounds] [-t turns] [-l TL] [-d field_dir] [-s seed] <config A> <config B>
+// config: random | greedy | route[:r]
+//   random  : select_random_next_agents_acts
+//   greedy  : enumerate_next_all_agents_acts の中で evaluate_field が最大の手
+//   route:r : 城からのチェビシェフ距離rの位置を建築予定として calculate_build_route (default r=2)
+#define ERRFILE "/dev/null"
+#include <time.h>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <filesystem>
+#include "base.hpp"
+#include "tsp.hpp"
+#if defined(__posix__)
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/wait.h>
+#endif
+
+struct Config {
+  static constexpr int Random = 0;
+  static constexpr int Greedy = 1;
+  static constexpr int Route = 2;
+
+  std::string name;
+  int type = Random;
+  int radius = 2;
+};
+
+Config parse_config(const std::string &str){
+  Config conf;
+  conf.name = str;
+  const auto pos = str.find(':');
+  const std::string type = str.substr(0, pos);
+  if(type == "random") conf.type = Config::Random;
+  else if(type == "greedy") conf.type = Config::Greedy;
+  else if(type == "route"){
+    conf.type = Config::Route;
+    if(pos != std::string::npos) conf.radius = std::stoi(str.substr(pos + 1));
+  }else{
+    std::fprintf(stderr, "unknown config: %s\n", str.c_str());
+    std::exit(1);
+  }
+  return conf;
+}
+
+Actions select_greedy_next_agents_acts(const Field &field){
+  const auto &agents = field.get_now_turn_agents();
+  const double sign = field.is_my_turn() ? 1 : -1;
+  Actions best;
+  double best_score = -1e18;
+  for(const auto &acts : enumerate_next_all_agents_acts(agents, field)){
+    if(!field.is_legal_action(acts)) continue;
+    Field f = field;
+    f.update_turn(acts);
+    if(chmax(best_score, Evaluate::evaluate_field(f) * sign)) best = acts;
+  }
+  if(best.empty()) return select_random_next_agents_acts(agents, field);
+  return best;
+}
+
+Actions select_next_agents_acts(const Config &conf, const Field &field, const Walls &plan){
+  if(conf.type == Config::Greedy) return select_greedy_next_agents_acts(field);
+  if(conf.type == Config::Route) return calculate_build_route(plan, field);
+  return select_random_next_agents_acts(field.get_now_turn_agents(), field);
+}
+
+
+constexpr int max_turns = 512;
+
+struct GameRecord {
+  int finished;
+  int score; // Aから見た最終スコア
+  int turns[2]; // [A, B]の手番数
+  float times[2][max_turns / 2]; // 1ターンの思考時間[ms]
+};
+
+struct GameSpec {
+  std::string path;
+  bool a_first;
+  uint seed;
+};
+
+void play_game(const GameSpec &spec, const Config conf[2], const int final_turn, const int TL, GameRecord &record){
+  rnd_seed(spec.seed);
+  Field field = read_field_csv(spec.path, 0, final_turn, TL);
+  // player[0]: 先攻(ally), player[1]: 後攻(enemy)
+  const int player[2] = { spec.a_first ? 0 : 1, spec.a_first ? 1 : 0 };
+  const Walls plan[2] = { make_build_plan(field, conf[player[0]].radius), make_build_plan(field, conf[player[1]].radius) };
+  record.turns[0] = record.turns[1] = 0;
+  while(!field.is_finished()){
+    const int p = field.is_my_turn() ? 0 : 1;
+    const int c = player[p];
+    StopWatch sw;
+    const Actions acts = select_next_agents_acts(conf[c], field, plan[p]);
+    record.times[c][record.turns[c]++] = sw.get_ms();
+    field.update_turn(acts);
+  }
+  const int score = field.calc_final_score();
+  record.score = spec.a_first ? score : -score;
+  record.finished = 1;
+}
+
+
+struct TimeStats {
+  std::vector<float> times;
+  void add(const float *t, const int n){ times.insert(times.end(), t, t + n); }
+  double percentile(const double p){
+    if(times.empty()) return 0;
+    std::sort(times.begin(), times.end());
+    return times[std::min((int)times.size() - 1, (int)(p * times.size()))];
+  }
+  double mean() const{
+    double sum = 0;
+    for(const float t : times) sum += t;
+    return times.empty() ? 0 : sum / times.size();
+  }
+};
+
+int main(int argc, char *argv[]){
+  int jobs = 1, rounds = 1, final_turn = 200, TL = 100;
+  uint seed = time(NULL);
+  std::string field_dir = "../visualizer/App/field";
+#if defined(__posix__)
+  jobs = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+  std::vector<std::string> args;
+  for(int i = 1; i < argc; i++){
+    const std::string opt = argv[i];
+    if(opt.size() == 2 && opt[0] == '-' && i + 1 < argc){
+      const std::string val = argv[++i];
+      if(opt == "-j") jobs = std::max(1, std::stoi(val));
+      else if(opt == "-n") rounds = std::stoi(val);
+      else if(opt == "-t") final_turn = std::stoi(val);
+      else if(opt == "-l") TL = std::stoi(val);
+      else if(opt == "-d") field_dir = val;
+      else if(opt == "-s") seed = std::stoul(val);
+      else args.emplace_back(opt), i--;
+    }else{
+      args.emplace_back(opt);
+    }
+  }
+  if(args.size() != 2 || final_turn > max_turns){
+    std::fprintf(stderr, "usage: %s [-j jobs] [-n rounds] [-t turns(<=%d)] [-l TL] [-d field_dir] [-s seed] <config A> <config B>\n", argv[0], max_turns);
+    std::fprintf(stderr, "config: random | greedy | route[:r]\n");
+    return 1;
+  }
+  const Config conf[2] = { parse_config(args[0]), parse_config(args[1]) };
+
+  std::vector<std::string> maps;
+  for(const auto &entry : std::filesystem::directory_iterator(field_dir)){
+    if(entry.path().extension() == ".csv") maps.emplace_back(entry.path().string());
+  }
+  std::sort(maps.begin(), maps.end());
+  if(maps.empty()){
+    std::fprintf(stderr, "no maps in %s\n", field_dir.c_str());
+    return 1;
+  }
+
+  std::vector<GameSpec> specs;
+  for(const auto &path : maps){
+    for(int r = 0; r < rounds; r++){
+      specs.push_back({ path, true, seed + (uint)specs.size() });
+      specs.push_back({ path, false, seed + (uint)specs.size() });
+    }
+  }
+  const int games_num = specs.size();
+
+  StopWatch total_sw;
+#if defined(__posix__)
+  // 対局ごとにプロセスを分ける (height, widthや関数内のstatic変数を共有しないため)
+  auto *records = (GameRecord*)mmap(nullptr, sizeof(GameRecord) * games_num, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  assert(records != MAP_FAILED);
+  std::memset(records, 0, sizeof(GameRecord) * games_num);
+  int running = 0;
+  for(int i = 0; i < games_num; i++){
+    if(running >= jobs){
+      wait(nullptr);
+      running--;
+    }
+    const pid_t pid = fork();
+    if(pid == 0){
+      play_game(specs[i], conf, final_turn, TL, records[i]);
+      _exit(0);
+    }
+    assert(pid > 0);
+    running++;
+  }
+  while(running > 0){
+    wait(nullptr);
+    running--;
+  }
+#else
+  std::vector<GameRecord> record_buf(games_num);
+  GameRecord *records = record_buf.data();
+  for(int i = 0; i < games_num; i++){
+    play_game(specs[i], conf, final_turn, TL, records[i]);
+  }
+#endif
+  const double elapsed = total_sw.get_ms();
+
+  std::printf("A: %s, B: %s, turns: %d, TL: %d[ms], games: %d, jobs: %d, seed: %u\n",
+              conf[0].name.c_str(), conf[1].name.c_str(), final_turn, TL, games_num, jobs, seed);
+  std::printf("%-8s %5s %5s %5s %9s\n", "map", "win", "draw", "lose", "margin");
+  int win = 0, draw = 0, lose = 0, failed = 0;
+  double margin_sum = 0, margin_sq_sum = 0;
+  TimeStats time_stats[2];
+  for(int i = 0; i < games_num; ){
+    const std::string &path = specs[i].path;
+    int w = 0, d = 0, l = 0, n = 0;
+    double sum = 0;
+    for(; i < games_num && specs[i].path == path; i++){
+      const GameRecord &rec = records[i];
+      if(!rec.finished){
+        failed++;
+        continue;
+      }
+      n++;
+      sum += rec.score;
+      margin_sum += rec.score;
+      margin_sq_sum += (double)rec.score * rec.score;
+      if(rec.score > 0) w++;
+      else if(rec.score < 0) l++;
+      else d++;
+      for(int c = 0; c < 2; c++) time_stats[c].add(rec.times[c], rec.turns[c]);
+    }
+    win += w; draw += d; lose += l;
+    const std::string name = std::filesystem::path(path).stem().string();
+    std::printf("%-8s %5d %5d %5d %9.2f\n", name.c_str(), w, d, l, n ? sum / n : 0.0);
+  }
+  const int played = win + draw + lose;
+  const double mean = played ? margin_sum / played : 0;
+  const double stddev = played ? std::sqrt(std::max(0.0, margin_sq_sum / played - mean * mean)) : 0;
+  std::printf("\n");
+  std::printf("A win rate: %.3f (%d-%d-%d), failed: %d\n", played ? (win + draw * 0.5) / played : 0.0, win, draw, lose, failed);
+  std::printf("A score margin: mean %.2f, stddev %.2f\n", mean, stddev);
+  for(int c = 0; c < 2; c++){
+    std::printf("%c time/turn[ms]: mean %.2f, p50 %.2f, p95 %.2f, max %.2f\n", "AB"[c],
+                time_stats[c].mean(), time_stats[c].percentile(0.5), time_stats[c].percentile(0.95), time_stats[c].percentile(1.0));
+  }
+  std::printf("elapsed: %.1f[s]\n", elapsed * 1e-3);
+}
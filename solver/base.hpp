@@ -1,9 +1,38 @@
 #pragma once
 
-#include <set>
+#include <queue>
+#include <functional>
 #include "field.hpp"
+#include "timer.hpp"
 
-Actions enumerate_next_agent_acts(const Agent &agent, const Field &field, const bool use_assert=true){
+// 1回の探索の統計 (telemetry用)
+struct SearchStats {
+  // 各段階の時間[ms]
+  double partition_ms = 0; // 壁を職人に割り振る
+  double tsp_ms = 0; // 各職人の壁の順番の初期解
+  double sa_ms = 0; // 焼きなまし
+  double extract_ms = 0; // 最初の行動の復元
+  double cost_table_ms = 0; // CostTableの計算 (上の各段階に含まれる)
+  int sa_steps = 0, sa_accepted = 0, sa_improved = 0;
+  ll evals = 0; // 割り振りの評価回数
+  ll cost_lookups = 0, cost_misses = 0; // CostTableの参照回数と計算した回数
+  int first_cost = 0, final_cost = 0; // 焼きなまし前後の最大移動コスト
+};
+
+// 探索の打ち切り条件と途中結果の受け取り先 (各探索で共通)
+struct SearchContext {
+  Deadline deadline;
+  int max_steps = 1 << 30; // 反復の最大回数 (再現性のある計測用)
+  std::function<void(const Actions&)> emit; // 暫定の最善手を受け取る (空なら呼ばない)
+  SearchStats *stats = nullptr; // 統計の書き込み先 (nullなら書かない)
+  std::vector<Walls> *routes = nullptr; // 最終的な職人ごとの壁の順番の書き込み先 (nullなら書かない)
+
+  SearchContext(const Deadline &_deadline) : deadline(_deadline){}
+  inline void emit_best(const Actions &acts) const{ if(emit) emit(acts); }
+};
+
+// 職人の合法な行動(待機以外)の集合
+ActionMask calc_agent_action_mask(const Agent &agent, const Field &field, const bool use_assert=true){
   const State ally = field.get_state(agent) & State::Human; // agentから見た味方
   const State enemy = ally ^ State::Human; // agentから見た敵
   if(use_assert) assert((ally == State::Enemy) == (field.current_turn & 1));
@@ -12,21 +41,27 @@ Actions enumerate_next_agent_acts(const Agent &agent, const Field &field, const
   const State ally_wall = ally == State::Ally ? State::WallAlly : State::WallEnemy; // agentから見た味方のwall
   const State enemy_wall = ally_wall ^ State::Wall; // agentから見た敵のwall
 
-  Actions actions;
+  ActionMask mask;
+  const int c = to_cell(agent);
   for(int dir = 0; dir < 8; dir++){
-    const auto nxt = agent + dmove[dir];
-    if(!is_valid(nxt)) continue;
-    const State st = field.get_state(nxt);
+    // 盤面外はState::Outsideなので、どの行動の条件も満たさない
+    const State st = field.get_cell(c + dcell[dir]);
     if(dir < 4){
       // break (自陣の壁の破壊は考慮しない)
-      if(st & enemy_wall) actions.emplace_back(Action(nxt, Action::Break));
+      if(st & enemy_wall) mask.set(Action::Break, dir);
       // build
-      if(!(st & (State::Wall | State::Castle | enemy))) actions.emplace_back(Action(nxt, Action::Build));
+      if(!(st & (State::Wall | State::Castle | enemy))) mask.set(Action::Build, dir);
     }
     // can move to nxt
-    if(!(st & (State::Pond | State::Human | enemy_wall))){
-      actions.emplace_back(Action(nxt, Action::Move));
-    }
+    if(!(st & (State::Pond | State::Human | enemy_wall))) mask.set(Action::Move, dir);
+  }
+  return mask;
+}
+
+AgentActions enumerate_next_agent_acts(const Agent &agent, const Field &field, const bool use_assert=true){
+  AgentActions actions;
+  for(uint m = calc_agent_action_mask(agent, field, use_assert).bits; m; m &= m - 1){
+    actions.emplace_back(ActionMask::to_action(ctz32(m)));
   }
   return actions;
 }
@@ -35,21 +70,26 @@ Actions enumerate_next_agent_acts(const Agent &agent, const Field &field, const
 // 適当に選ぶ
 Actions select_random_next_agents_acts(const Agents &agents, const Field &field){
   Actions result;
-  std::set<Action> cnt;
+  std::pair<uchar,Point> used[max_agent_num]; // 選んだ行動の(command, 対象の場所)
+  int used_num = 0;
   for(const auto &agent : agents){
     assert(((field.get_state(agent) & State::Human) == State::Enemy) == (field.current_turn & 1));
-    auto acts = enumerate_next_agent_acts(agent, field);
-    if(acts.empty()) acts.emplace_back(Action(agent, Action::None));
+    const ActionMask mask = calc_agent_action_mask(agent, field);
+    const int acts_num = std::max(1, mask.size());
+    const auto nth = [&](const int i){ return mask.empty() ? Action(Action::None) : mask.nth(i); };
+    const auto key = [&](const Action act){
+      return std::make_pair(act.command(), act.command() == Action::None ? (Point)agent : act.target(agent));
+    };
+    const auto is_used = [&](const Action act){
+      return std::find(used, used + used_num, key(act)) != used + used_num;
+    };
     int num = 0;
-    int idx = rnd(acts.size());
-    while(num++ < 10 && cnt.count(acts[idx])) idx = rnd(acts.size());
-    if(num >= 10){
-      acts.emplace_back(Action(agent, Action::None));
-      idx = (int)acts.size() - 1;
-    }
-    cnt.insert(acts[idx]);
-    result.emplace_back(acts[idx]);
-    result.back().agent_idx = (int)result.size() - 1;
+    Action act = nth(rnd(acts_num));
+    while(num++ < 10 && is_used(act)) act = nth(rnd(acts_num));
+    if(num >= 10) act = Action(Action::None);
+    if(!is_used(act)) used[used_num++] = key(act);
+    result.emplace_back(act);
+    result.back().set_agent_idx((int)result.size() - 1);
   }
   return result;
 }
@@ -67,6 +107,29 @@ std::vector<Actions> enumerate_next_all_agents_acts(const Agents &agents, const
 }
 
 
+// 城からのチェビシェフ距離がrの位置を建築予定の壁とする
+Walls make_build_plan(const Field &field, const int r){
+  Walls walls;
+  for(int i = 0; i < height; i++){
+    for(int j = 0; j < width; j++){
+      const Point p(i, j);
+      if(field.get_state(p) & (State::Pond | State::Castle)) continue;
+      int min_dist = 1000;
+      for(const auto castle : field.castles) chmin(min_dist, che_dist(p, castle));
+      if(min_dist != r) continue;
+      // 上下左右が全て池の場合は建てられない
+      bool reachable = false;
+      for(int dir = 0; dir < 4; dir++){
+        const Point nxt = p + dmove[dir];
+        if(is_valid(nxt) && !(field.get_state(nxt) & State::Pond)) reachable = true;
+      }
+      if(reachable) walls.emplace_back(p);
+    }
+  }
+  return walls;
+}
+
+
 namespace Evaluate {
 
 int calc_agent_min_dist(const Field &field, const Agents &ally_agents, const State area){
@@ -83,10 +146,11 @@ int calc_agent_min_dist(const Field &field, const Agents &ally_agents, const Sta
   return dc;
 }
 
+template <class B>
 int calc_wall_min_dist(const Field &field, const State wall){
   int dw = 0;
-  for(int i = 0; i < height; i++){
-    for(int j = 0; j < width; j++) if(field.get_state(i, j) & wall){
+  for(int i = 0; i < B::h(); i++){
+    for(int j = 0; j < B::w(); j++) if(field.get_state(i, j) & wall){
       int min_dist = 1000;
       for(const auto castle : field.castles){
         const int d = manche_dist(Point(i, j), castle);
@@ -98,11 +162,11 @@ int calc_wall_min_dist(const Field &field, const State wall){
   return dw;
 }
 
-template <class F>
+template <class B, class F>
 std::vector<std::vector<int>> calc_castle_min_dist(const Field &field, const F &dist){
-  std::vector<std::vector<int>> res(height, std::vector<int>(width));
-  for(int i = 0; i < height; i++){
-    for(int j = 0; j < width; j++){
+  std::vector<std::vector<int>> res(B::h(), std::vector<int>(B::w()));
+  for(int i = 0; i < B::h(); i++){
+    for(int j = 0; j < B::w(); j++){
       int min_dist = 1000;
       for(const auto castle : field.castles){
         const int d = dist(Point(i, j), castle);
@@ -114,12 +178,13 @@ std::vector<std::vector<int>> calc_castle_min_dist(const Field &field, const F &
   return res;
 }
 
+template <class B>
 double calc_around_wall(const Field &field, const State wall){
   static constexpr int C = 4;
-  static std::vector<std::vector<int>> dist_table = calc_castle_min_dist(field, manche_dist);
+  static std::vector<std::vector<int>> dist_table = calc_castle_min_dist<B>(field, manche_dist);
   int wall_num = 0, mass = 0;
-  for(int i = 0; i < height; i++){
-    for(int j = 0; j < width; j++) if(dist_table[i][j] <= C){
+  for(int i = 0; i < B::h(); i++){
+    for(int j = 0; j < B::w(); j++) if(dist_table[i][j] <= C){
       if(field.get_state(i, j) & wall) wall_num++;
       mass++;
     }
@@ -127,37 +192,40 @@ double calc_around_wall(const Field &field, const State wall){
   return (double)wall_num / mass;
 }
 
+template <class B>
 double calc_nearest_wall(const Field &field, const State wall){
-  static std::vector<std::vector<int>> dist_table = calc_castle_min_dist(field, manche_dist);
+  static std::vector<std::vector<int>> dist_table = calc_castle_min_dist<B>(field, manche_dist);
   double res = 0;
-  for(int i = 0; i < height; i++){
-    for(int j = 0; j < width; j++) if(field.get_state(i, j) & wall){
+  for(int i = 0; i < B::h(); i++){
+    for(int j = 0; j < B::w(); j++) if(field.get_state(i, j) & wall){
       res += 1.0 / (dist_table[i][j] * dist_table[i][j]);
     }
   }
   return res;
 }
 
+template <class B>
 int calc_connected_wall(const Field &field, const State wall){
-  static std::queue<Point> que;
-  static std::vector<std::vector<int>> used(height, std::vector<int>(width));
+  static std::queue<int> que;
+  static std::vector<int> used(padded_size);
   static int unused = 0;
   int res = 0;
-  for(int i = 0; i < height; i++){
-    for(int j = 0; j < width; j++){
-      if((field.get_state(i, j) & wall) && used[i][j] <= unused){
+  for(int i = 0; i < B::h(); i++){
+    for(int j = 0; j < B::w(); j++){
+      const int c = to_cell(Point(i, j));
+      if((field.get_cell(c) & wall) && used[c] <= unused){
         int num = 0;
-        used[i][j] = unused + 1;
-        que.push(Point(i, j));
+        used[c] = unused + 1;
+        que.push(c);
         while(!que.empty()){
-          const auto pos = que.front();
+          const int pos = que.front();
           que.pop();
           num++;
           for(int dir = 0; dir < 8; dir++){
-            const auto nxt = pos + dmove[dir];
-            if(!is_valid(nxt) || !(field.get_state(nxt) & wall)) continue;
-            if(used[nxt.y][nxt.x] <= unused){
-              used[nxt.y][nxt.x] = unused + 1;
+            const int nxt = pos + dcell[dir];
+            if(!(field.get_cell(nxt) & wall)) continue;
+            if(used[nxt] <= unused){
+              used[nxt] = unused + 1;
               que.push(nxt);
             }
           }
@@ -171,13 +239,13 @@ int calc_connected_wall(const Field &field, const State wall){
   return res;
 }
 
+template <class B>
 int calc_wall_by_enemy(const Field &field, const Agents &enemy_agents, const State wall){
   int res = 0;
   for(const auto agent : enemy_agents){
+    const int c = to_cell(agent);
     for(int dir = 0; dir < 4; dir++){
-      const auto nxt = agent + dmove[dir];
-      if(!is_valid(nxt)) continue;
-      if(field.get_state(nxt) & wall) res++;
+      if(field.get_cell(c + dcell[dir]) & wall) res++;
     }
   }
   return res;
@@ -219,21 +287,22 @@ double evaluate_field(const Field &field){
   return field.calc_final_score() * 0.1 * 0.5;
 }
 
+template <class B>
 double evaluate_field2(const Field &field){
   // eval #1: 各職人から一番近い城までの距離^2の総和
   const int dc = calc_agent_min_dist(field, field.ally_agents, State::AreaAlly) - calc_agent_min_dist(field, field.enemy_agents, State::AreaEnemy);
   // eval #2: 各城壁から一番近い城との距離の総和
-  const int dw = calc_wall_min_dist(field, State::WallAlly) - calc_wall_min_dist(field, State::WallEnemy);
+  const int dw = calc_wall_min_dist<B>(field, State::WallAlly) - calc_wall_min_dist<B>(field, State::WallEnemy);
   // eval #3: 各城を中心として、((距離がC以内にある城壁の個数)/(対象のマスの数))
-  const double pw = calc_around_wall(field, State::WallAlly) - calc_around_wall(field, State::WallEnemy);
+  const double pw = calc_around_wall<B>(field, State::WallAlly) - calc_around_wall<B>(field, State::WallEnemy);
   // eval #4: 1/(壁から一番近い城までの距離^2)の総和
-  const double wd = calc_nearest_wall(field, State::WallAlly) - calc_nearest_wall(field, State::WallEnemy);
+  const double wd = calc_nearest_wall<B>(field, State::WallAlly) - calc_nearest_wall<B>(field, State::WallEnemy);
   // eval #5: 城壁の各連結成分の大きさ^2の総和
-  const int w = calc_connected_wall(field, State::WallAlly) - calc_connected_wall(field, State::WallEnemy);
+  const int w = calc_connected_wall<B>(field, State::WallAlly) - calc_connected_wall<B>(field, State::WallEnemy);
   // eval #6: 城、領域、壁の数
   const int n = field.calc_final_score();
   // eval #7: 敵の職人のマンハッタン距離1以内に置かれている壁の数
-  const int wn = calc_wall_by_enemy(field, field.enemy_agents, State::WallAlly) - calc_wall_by_enemy(field, field.ally_agents, State::WallEnemy);
+  const int wn = calc_wall_by_enemy<B>(field, field.enemy_agents, State::WallAlly) - calc_wall_by_enemy<B>(field, field.ally_agents, State::WallEnemy);
 
   static constexpr double a = 0.004;
   static constexpr double b = 0.007;
@@ -251,5 +320,8 @@ double evaluate_field2(const Field &field){
   res -= wn * f;
   return res * 0.5;
 }
+double evaluate_field2(const Field &field){
+  return with_board([&](auto board){ return evaluate_field2<decltype(board)>(field); });
+}
 
 }
@@ -0,0 +1,161 @@
+// solverの主要な処理のマイクロベンチマーク
+// visualizer/App/field/*.csvの各盤面で途中局面を作り、各処理のns/opをCSVで出力する
+//
+// usage: bench [-d field_dir] [-w warmup_ms] [-r samples] [-b batch_ms] [-p turns] [map...]
+//   map    : 計測する盤面名(A11など), 省略時は全盤面
+//   output : map,height,width,bench,ops,ns_per_op,min_ns_per_op,max_ns_per_op (ns_per_opは中央値)
+#define ERRFILE "/dev/null"
+#include <cstdio>
+#include <string>
+#include <filesystem>
+#include "base.hpp"
+#include "tsp.hpp"
+
+using bench_clock = std::chrono::steady_clock;
+
+constexpr uint bench_seed = 1210253353;
+constexpr int route_steps = 2000; // calculate_build_routeのSAのステップ数
+
+int warmup_ms = 50, samples = 7, batch_ms = 20;
+volatile ll sink = 0; // 最適化で処理が消されないようにする
+
+inline double elapsed_ns(const bench_clock::time_point start){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count();
+}
+
+// 1 batchがbatch_ms以上になるように回数を決めてから、samples回計測する
+template <class F>
+void bench(const std::string &map, const char *name, const F &f){
+  const auto warmup_start = bench_clock::now();
+  ll batch = 0;
+  while(elapsed_ns(warmup_start) < warmup_ms * 1e6 || batch == 0){
+    sink += f();
+    batch++;
+  }
+  batch = std::max(1LL, (ll)(batch * batch_ms / std::max(1, warmup_ms)));
+
+  std::vector<double> ns_per_op(samples);
+  for(int s = 0; s < samples; s++){
+    const auto start = bench_clock::now();
+    for(ll i = 0; i < batch; i++) sink += f();
+    ns_per_op[s] = elapsed_ns(start) / batch;
+  }
+  std::sort(ns_per_op.begin(), ns_per_op.end());
+  std::printf("%s,%d,%d,%s,%lld,%.1f,%.1f,%.1f\n", map.c_str(), height, width, name,
+              batch * samples, ns_per_op[samples / 2], ns_per_op.front(), ns_per_op.back());
+  std::fflush(stdout);
+}
+
+// 両チームがcalculate_build_routeで壁を建てた途中局面を作る
+Field make_position(const std::string &path, const int turns){
+  rnd_seed(bench_seed);
+  Field field = read_field_csv(path, 0, 1 << 20, 1 << 20);
+  const Walls plan = make_build_plan(field, 2);
+  for(int t = 0; t < turns; t++){
+    field.update_turn(calculate_build_route(plan, field, route_steps));
+  }
+  return field;
+}
+
+void run_benchmarks(const std::string &path, const int position_turns){
+  const std::string map = std::filesystem::path(path).stem().string();
+  const Field base = make_position(path, position_turns);
+  const Agents &agents = base.get_now_turn_agents();
+  const State ally_wall = base.is_my_turn() ? State::WallAlly : State::WallEnemy;
+  const State enemy_wall = ally_wall ^ State::Wall;
+
+  rnd_seed(bench_seed);
+  Actions acts = select_random_next_agents_acts(agents, base);
+  Walls plan;
+  for(const Wall w : make_build_plan(base, 2)){
+    if(!(base.get_state(w) & ally_wall)) plan.emplace_back(w);
+  }
+
+  bench(map, "field_copy", [&]{
+    Field f = base;
+    return (ll)f.current_turn;
+  });
+  Field region_field = base;
+  bench(map, "update_region", [&]{
+    region_field.update_region();
+    return (ll)(bool)region_field.get_state(0, 0);
+  });
+  bench(map, "update_field", [&]{
+    Field f = base;
+    f.update_field(acts);
+    return (ll)(bool)f.get_state(0, 0);
+  });
+  bench(map, "calc_final_score", [&]{
+    return (ll)base.calc_final_score();
+  });
+  bench(map, "enumerate_next_agent_acts", [&]{
+    ll n = 0;
+    for(const Agent &agent : agents) n += enumerate_next_agent_acts(agent, base).size();
+    return n;
+  });
+  bench(map, "calc_agent_action_mask", [&]{
+    ll n = 0;
+    for(const Agent &agent : agents) n += calc_agent_action_mask(agent, base).size();
+    return n;
+  });
+  std::vector<int> dist, prev;
+  bench(map, "calc_move_min_cost", [&]{
+    TSP::calc_move_min_cost(agents[0], base, enemy_wall, dist, prev);
+    return (ll)dist[0];
+  });
+  bench(map, "cost_table_fill", [&]{
+    TSP::CostTable cost_table(base, enemy_wall);
+    ll sum = 0;
+    for(int i = 0; i < height; i++){
+      for(int j = 0; j < width; j++) sum += cost_table.get_cost(Point(i, j), agents[0]);
+    }
+    return sum;
+  });
+  if(!plan.empty()){
+    TSP::CostTable cost_table(base, enemy_wall);
+    const Walls part(plan.begin(), plan.begin() + (plan.size() + agents.size() - 1) / agents.size());
+    const Walls route = TSP::calc_tsp_route(agents[0], part, cost_table);
+    bench(map, "calc_agent_move_cost", [&]{
+      return (ll)TSP::calc_agent_move_cost(agents[0], route, base, cost_table);
+    });
+  }
+  bench(map, "calculate_build_route", [&]{
+    rnd_seed(bench_seed);
+    return (ll)calculate_build_route(plan, base, route_steps)[0].command();
+  });
+}
+
+int main(int argc, char *argv[]){
+  std::string field_dir = "../visualizer/App/field";
+  int position_turns = 40;
+  std::vector<std::string> filter;
+  for(int i = 1; i < argc; i++){
+    const std::string opt = argv[i];
+    if(opt.size() == 2 && opt[0] == '-' && i + 1 < argc){
+      const std::string val = argv[++i];
+      if(opt == "-d") field_dir = val;
+      else if(opt == "-w") warmup_ms = std::max(1, std::stoi(val));
+      else if(opt == "-r") samples = std::max(1, std::stoi(val));
+      else if(opt == "-b") batch_ms = std::max(1, std::stoi(val));
+      else if(opt == "-p") position_turns = std::stoi(val);
+      else{
+        std::fprintf(stderr, "usage: %s [-d field_dir] [-w warmup_ms] [-r samples] [-b batch_ms] [-p turns] [map...]\n", argv[0]);
+        return 1;
+      }
+    }else{
+      filter.emplace_back(opt);
+    }
+  }
+
+  std::vector<std::string> maps;
+  for(const auto &entry : std::filesystem::directory_iterator(field_dir)){
+    const auto &p = entry.path();
+    if(p.extension() != ".csv") continue;
+    if(!filter.empty() && std::find(filter.begin(), filter.end(), p.stem().string()) == filter.end()) continue;
+    maps.emplace_back(p.string());
+  }
+  std::sort(maps.begin(), maps.end());
+
+  std::printf("map,height,width,bench,ops,ns_per_op,min_ns_per_op,max_ns_per_op\n");
+  for(const auto &path : maps) run_benchmarks(path, position_turns);
+}
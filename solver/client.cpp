@@ -0,0 +1,174 @@
+// 試合サーバーと直接通信して対戦するヘッドレスのクライアント (visualizerを使わない)
+// solverの処理はcomputer.cppと同じGame(game.hpp)をこのプロセスの中で呼び、
+// 相手のターンが終わるたびにサーバーの盤面で同期する
+// 自分のターンは探索中の暫定の行動をすぐに送り、以降は行動が変わったときだけ送り直す
+//
+// usage: client [-h host] [-p port] [-t token] [-m match_id] [-i poll_ms] [-w radius] [-r record_dir]
+//   token, match_id : 省略した場合はvisualizerと同じくtoken.env, id.envの1行目
+//   radius          : 城からのチェビシェフ距離radiusの位置を建築予定にする (default 2)
+//   record_dir      : 受け取った試合一覧と各ターンの状況をそのまま保存する (replay_serverで再生できる)
+#include <time.h>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include "game.hpp"
+#include "http.hpp"
+#include "match.hpp"
+
+std::string read_first_line(const std::string &path){
+  std::ifstream is(path);
+  std::string line;
+  std::getline(is, line);
+  while(!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+  return line;
+}
+
+void save(const std::string &dir, const std::string &name, const std::string &body){
+  if(dir.empty()) return;
+  std::ofstream(std::filesystem::path(dir) / name) << body;
+}
+
+int main(int argc, char *argv[]){
+  std::string host = "localhost", token, record_dir;
+  int port = 3000, match_id = -1, poll_ms = 50, radius = 2;
+  for(int i = 1; i < argc; i++){
+    const std::string opt = argv[i];
+    if(opt.size() == 2 && opt[0] == '-' && i + 1 < argc){
+      const std::string val = argv[++i];
+      if(opt == "-h") host = val;
+      else if(opt == "-p") port = std::stoi(val);
+      else if(opt == "-t") token = val;
+      else if(opt == "-m") match_id = std::stoi(val);
+      else if(opt == "-i") poll_ms = std::max(1, std::stoi(val));
+      else if(opt == "-w") radius = std::stoi(val);
+      else if(opt == "-r") record_dir = val;
+      else{
+        std::fprintf(stderr, "usage: %s [-h host] [-p port] [-t token] [-m match_id] [-i poll_ms] [-w radius] [-r record_dir]\n", argv[0]);
+        return 1;
+      }
+    }
+  }
+  if(token.empty()) token = read_first_line("token.env");
+  if(match_id < 0) match_id = std::atoi(read_first_line("id.env").c_str());
+  if(!record_dir.empty()) std::filesystem::create_directories(record_dir);
+  srand(time(NULL));
+
+  HttpClient http(host, port);
+  const std::string query = "?token=" + token;
+  const std::string match_path = "/matches/" + std::to_string(match_id) + query;
+  const auto wait = [&]{ std::this_thread::sleep_for(std::chrono::milliseconds(poll_ms)); };
+  HttpResponse res;
+
+  // 試合一覧から対象の試合を探す (始まるまで待つ)
+  Match::MatchInfo info;
+  while(true){
+    Json json;
+    if(http.get("/matches" + query, res) && res.status == 200 && Json::parse(res.body, json) && info.parse(json, match_id)) break;
+    cerror << "GET /matches failed (status " << res.status << ")\n";
+    wait();
+  }
+  save(record_dir, "matches.json", res.body);
+  cerr << "match " << info.id << ": " << info.height << "x" << info.width << ", " << info.turns << " turns, "
+       << info.turn_seconds << "[s], " << (info.first ? "first" : "second") << "\n";
+
+  // 暫定の行動はGameの送信用のスレッドから送るので、最終的な行動とは別の接続を使う
+  // 最終的な行動は送信中の暫定の行動を待たずに送り、暫定の行動が後に届いた可能性があれば送り直す
+  HttpClient progress_http(host, port);
+  std::mutex post_mtx;
+  int post_turn = 0; // 出力する行動のターン (1-indexed, runの間は変えない)
+  int posted_turn = -1; // 最後に届いた行動
+  Actions posted_acts;
+  int final_turn = -1; // 最後に最終的な行動を送ったターン
+  Actions final_acts;
+  bool progress_in_flight = false;
+  const auto send = [&](HttpClient &client, const Actions &acts){
+    HttpResponse post_res;
+    if(!client.post(match_path, Match::action_plan_json(post_turn, acts), post_res) || post_res.status != 200){
+      cerror << "POST turn " << post_turn << " failed (status " << post_res.status << ")\n";
+      return false;
+    }
+    return true;
+  };
+  const auto post_final = [&](const Actions &acts){
+    {
+      std::lock_guard<std::mutex> lock(post_mtx);
+      final_turn = post_turn;
+      final_acts = acts;
+      if(!progress_in_flight && posted_turn == post_turn && posted_acts == acts) return;
+    }
+    if(!send(http, acts)) return;
+    std::lock_guard<std::mutex> lock(post_mtx);
+    posted_turn = post_turn;
+    posted_acts = acts;
+  };
+  const auto post_progress = [&](const Actions &acts){
+    {
+      std::lock_guard<std::mutex> lock(post_mtx);
+      if(final_turn == post_turn || (posted_turn == post_turn && posted_acts == acts)) return;
+      progress_in_flight = true;
+    }
+    const bool ok = send(progress_http, acts);
+    Actions resend;
+    {
+      std::lock_guard<std::mutex> lock(post_mtx);
+      progress_in_flight = false;
+      if(ok){
+        posted_turn = post_turn;
+        posted_acts = acts;
+      }
+      // 送っている間に最終的な行動を送っていたら、こちらが後に届いたかもしれない
+      if(!ok || final_turn != post_turn || final_acts == acts) return;
+      resend = final_acts;
+    }
+    if(send(progress_http, resend)){
+      std::lock_guard<std::mutex> lock(post_mtx);
+      posted_acts = resend;
+    }
+  };
+  Game game(info.make_field(), post_final);
+  game.progress = post_progress;
+  game.build_walls = make_build_plan(game.field, radius);
+  game.field.debug();
+
+  int last_turn = -1;
+  while(!game.field.is_finished()){
+    Json json;
+    Match::MatchStatus status;
+    if(!http.get(match_path, res) || res.status != 200 || !Json::parse(res.body, json) || !status.parse(json)){
+      cerror << "GET " << match_path << " failed (status " << res.status << ")\n";
+      wait();
+      continue;
+    }
+    if(status.turn == last_turn){
+      wait();
+      continue;
+    }
+    last_turn = status.turn;
+    game.time_manager.start_turn(); // ターンが変わったのを見つけた時点から測る
+    save(record_dir, "status_" + std::to_string(10000 + status.turn).substr(1) + ".json", res.body);
+
+    // サーバーのターンまで進める (自分のターンは出力した時点で進んでいる)
+    Field &field = game.field;
+    while(field.current_turn < status.turn){
+      if(field.is_my_turn()){
+        cerror << "missed turn " << field.current_turn + 1 << "\n";
+        field.update_turn(status.log_actions(field.current_turn + 1, field.ally_agents.size()));
+      }else{
+        game.update_enemy_turn(status.log_actions(field.current_turn + 1, field.enemy_agents.size()), false);
+      }
+    }
+    if(field.current_turn != status.turn) continue;
+    game.snapshot = status.snapshot;
+    if(const int diff = field.apply_snapshot(game.snapshot)){
+      cerr << "Resync: " << diff << " cells/agents differed from the server\n";
+    }
+    if(field.is_finished() || !field.is_my_turn()) continue;
+
+    post_turn = status.turn + 1;
+    game.run();
+    cerr << "Elapsed Time: " << game.time_manager.turn_elapsed_ms() << "[ms]\n";
+  }
+  cerr << "Finished\n";
+  dump_trace();
+  alloc_report();
+}
@@ -1,88 +1,52 @@
 #include <time.h>
-#include "base.hpp"
-#include "tsp.hpp"
+#include "game.hpp"
 
-struct Game {
-  Field field;
-  Walls build_walls;
-  Game(const Field &f) : field(f){}
-  void run(){
-    assert(field.is_my_turn());
-    const auto &current_agents = field.get_now_turn_agents();
-    cerr << "run\n";
-
-    Actions res = calculate_build_route(build_walls, field);
-    const int m = res.size();
-    std::vector<int> dirs(m);
-    std::vector<std::string> cmd(m, "none");
-    for(int i = 0; i < m; i++){
-      assert(i == res[i].agent_idx);
-      for(int d = 0; d < 8; d++){
-        if(current_agents[i] + dmove[d] == res[i].pos){
-          dirs[i] = d;
-          break;
-        }
-      }
-    }
-    field.update_turn_and_fix_actions(res);
-    for(int i = 0; i < m; i++){
-      if(res[i].command == Action::Move) cmd[i] = "move";
-      if(res[i].command == Action::Build) cmd[i] = "build";
-      if(res[i].command == Action::Break) cmd[i] = "break";
-    }
-    field.debug();
-    cerr << "my turn\n";
-    for(int i = 0; i < m; i++){
-      std::cout << dirs[i] << " " << cmd[i] << "\n";
-      cerr << dirs[i] << " " << cmd[i] << "\n";
-    }
+// visualizerから相手のターンの入力を読む
+void load(Game &game, const Protocol::Mode mode){
+  // 相手の行動が届いた時点から自分のターンの時間を測る
+  {
+    TRACE_SCOPE("wait_input");
+    std::cin >> std::ws; // 前の行の改行を読み飛ばして、次の入力が届くまで待つ
   }
-
-  void load(){
-    assert(!field.is_my_turn());
-    const auto &current_agents = field.get_now_turn_agents();
-    std::vector<Action> res;
-    cerr << "enemy turn\n";
-    for(int i = 0; i < (int)current_agents.size(); i++){
-      int dir; std::string str;
-      std::cin >> dir >> str;
-      cerr << dir << " " << str << "\n";
-      uchar cmd = Action::None;
-      if(str == "move") cmd = Action::Move;
-      if(str == "build") cmd = Action::Build;
-      if(str == "break") cmd = Action::Break;
-      res.emplace_back(Action(current_agents[i] + dmove[dir], cmd, i));
-    }
-    build_walls.clear();
-    int walls_num;
-    std::cin >> walls_num;
-    for(int i = 0; i < walls_num; i++){
-      Point p;
-      std::cin >> p;
-      build_walls.push_back(p);
-    }
-    field.update_turn(res);
-    field.debug();
-  }
-};
+  TRACE_SCOPE("Game::load");
+  game.time_manager.start_turn();
+  const bool resync = Protocol::read_snapshot(mode, game.snapshot);
+  const Actions res = Protocol::read_actions(mode, game.field.get_now_turn_agents().size());
+  game.build_walls = Protocol::read_build_plan(mode);
+  game.update_enemy_turn(res, resync);
+}
 
 
 
 int main(){
   srand(time(NULL));
-  std::cin >> height >> width;
-  Field field = read_field(height, width);
+  const Protocol::Mode mode = Protocol::negotiate();
+  Field field = Protocol::read_field(mode);
   field.debug();
 
-  Game game(field);
+  // 暫定の行動は別のスレッドから書くので、標準出力への書き込みを直列にし、最終的な行動より後には書かない
+  std::mutex write_mtx;
+  bool final_written = false;
+  Game game(field, [&](const Actions &acts){
+    std::lock_guard<std::mutex> lock(write_mtx);
+    Protocol::write_actions(mode, acts);
+    final_written = true;
+  });
+  game.progress = [&](const Actions &acts){
+    std::lock_guard<std::mutex> lock(write_mtx);
+    if(!final_written) Protocol::write_actions(mode, acts, true);
+  };
+  game.insight = [mode](const Protocol::TurnInsight &insight){ Protocol::write_insight(mode, insight); };
   while(!game.field.is_finished()){
     if(game.field.is_my_turn()){
-      StopWatch sw;
+      final_written = false;
       game.run();
-      cerr << "Elapsed Time: " << sw.get_ms() << "[ms]\n";
+      cerr << "Elapsed Time: " << game.time_manager.turn_elapsed_ms() << "[ms]\n";
     }else{
-      game.load();
+      load(game, mode);
     }
   }
   cerr << "Finished\n";
+  dump_trace();
+  alloc_report();
 }
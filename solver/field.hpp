@@ -1,29 +1,129 @@
 #pragma once
 
-#include <queue>
-#include <map>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#if defined(__BMI2__)
+  #include <immintrin.h>
+#endif
 #include "lib.hpp"
+#include "trace.hpp"
 
 
+// command(2bit) | dir(3bit) | agent_idx(3bit) を1byteに詰める
 struct Action {
   static constexpr uchar None = 0;
   static constexpr uchar Break = 1;
   static constexpr uchar Build = 2;
   static constexpr uchar Move = 3;
 
-  uchar command; int agent_idx;
-  Point pos;
+  // dirは移動先/構築/破壊の対象の方向(dmoveの添字)、構築/破壊は0~3
+  inline constexpr Action(const uchar _cmd=None, const int _dir=0, const int _agent_idx=0) : val(_cmd | _dir << 2 | _agent_idx << 5){
+    assert(0 <= _cmd && _cmd < 4);
+    assert(0 <= _dir && _dir < (_cmd == Move || _cmd == None ? 8 : 4));
+    assert(0 <= _agent_idx && _agent_idx < max_agent_num);
+  }
+  inline constexpr uchar command() const noexcept{ return val & 3; }
+  inline constexpr int dir() const noexcept{ return val >> 2 & 7; }
+  inline constexpr int agent_idx() const noexcept{ return val >> 5; }
+  inline constexpr void set_command(const uchar cmd) noexcept{ val = (val & ~3) | cmd; }
+  inline constexpr void set_agent_idx(const int idx) noexcept{ val = (val & 31) | idx << 5; }
+  // agentの位置から見た対象の場所
+  inline constexpr Point target(const Point agent) const noexcept{ return agent + dmove[dir()]; }
+  inline constexpr bool operator<(const Action &act) const{ return val < act.val; }
+  inline constexpr bool operator==(const Action &act) const{ return val == act.val; }
+  inline constexpr bool operator!=(const Action &act) const{ return val != act.val; }
+
+private:
+  uchar val;
+};
+static_assert(sizeof(Action) == 1);
+
+// 1人の職人の行動(待機以外)の集合, bit: dir*3 + command-1 の24bit
+// 方向ごとに 破壊, 建築, 移動 の順に並べているので、下位bitから見るとenumerate_next_agent_actsと同じ順になる
+struct ActionMask {
+  static constexpr int bits_num = 24;
+
+  inline constexpr ActionMask(const uint _bits=0) : bits(_bits){}
+  static inline constexpr int to_bit(const uchar cmd, const int dir) noexcept{ return dir*3 + cmd - 1; }
+  static inline constexpr Action to_action(const int bit) noexcept{ return Action(bit % 3 + 1, bit / 3); }
+  inline constexpr void set(const uchar cmd, const int dir) noexcept{ bits |= 1u << to_bit(cmd, dir); }
+  inline constexpr bool contains(const Action act) const noexcept{
+    return act.command() != Action::None && (bits >> to_bit(act.command(), act.dir()) & 1);
+  }
+  inline constexpr int size() const noexcept{ return popcount32(bits); }
+  inline constexpr bool empty() const noexcept{ return !bits; }
+  // 下位bitから数えてi番目(0-indexed)の行動
+  inline Action nth(const int i) const noexcept{
+    assert(0 <= i && i < size());
+#if defined(__BMI2__)
+    return to_action(ctz32(_pdep_u32(1u << i, bits)));
+#else
+    uint m = bits;
+    for(int k = 0; k < i; k++) m &= m - 1;
+    return to_action(ctz32(m));
+#endif
+  }
+
+  uint bits;
+};
 
-  // posは移動先を表す、構築/破壊はその対象の場所がposになる
-  inline constexpr Action(const Point &_p, const uchar _cmd, const int _agent_idx=-1) : pos(_p), command(_cmd), agent_idx(_agent_idx){
-    assert(0 <= command && command < 4);
+// ヒープ確保をしない固定容量のActionの配列
+// 未使用の要素は常に0にしておき、比較/ハッシュをメモリ全体で行う
+template <int N>
+struct ActionArray {
+  inline constexpr ActionArray() : data{}, num(0){}
+  inline constexpr ActionArray(const int n, const Action act) : data{}, num(0){
+    for(int i = 0; i < n; i++) push_back(act);
+  }
+  inline constexpr int size() const noexcept{ return num; }
+  inline constexpr bool empty() const noexcept{ return !num; }
+  inline constexpr void push_back(const Action act) noexcept{
+    assert(num < N);
+    data[num++] = act;
   }
-  inline constexpr bool operator<(const Action &act) const{
-    if(command != act.command) return command < act.command;
-    return pos < act.pos;
+  inline constexpr void emplace_back(const Action act) noexcept{ push_back(act); }
+  inline constexpr void pop_back() noexcept{
+    assert(num > 0);
+    data[--num] = Action();
+  }
+  inline constexpr void clear() noexcept{ *this = ActionArray(); }
+  inline constexpr Action &operator[](const int i) noexcept{ assert(0 <= i && i < num); return data[i]; }
+  inline constexpr const Action &operator[](const int i) const noexcept{ assert(0 <= i && i < num); return data[i]; }
+  inline constexpr Action &back() noexcept{ return data[num - 1]; }
+  inline constexpr Action *begin() noexcept{ return data; }
+  inline constexpr Action *end() noexcept{ return data + num; }
+  inline constexpr const Action *begin() const noexcept{ return data; }
+  inline constexpr const Action *end() const noexcept{ return data + num; }
+  inline bool operator==(const ActionArray &a) const noexcept{ return std::memcmp(this, &a, sizeof(ActionArray)) == 0; }
+  inline bool operator!=(const ActionArray &a) const noexcept{ return !(*this == a); }
+  inline bool operator<(const ActionArray &a) const noexcept{ return std::memcmp(this, &a, sizeof(ActionArray)) < 0; }
+
+private:
+  Action data[N];
+  uchar num;
+};
+
+// 全職人の行動の組: max_agent_num人分 + 個数 で8byteに収まる
+using Actions = ActionArray<max_agent_num + 1>;
+static_assert(sizeof(Actions) == sizeof(ull));
+// 1人の職人の行動候補: 移動8 + 建築4 + 破壊4 + 待機
+using AgentActions = ActionArray<17>;
+
+template <>
+struct std::hash<Action> {
+  inline size_t operator()(const Action act) const noexcept{
+    uchar val;
+    std::memcpy(&val, &act, sizeof(val));
+    return val;
   }
-  inline constexpr bool operator==(const Action &act) const{
-    return command == act.command && agent_idx == act.agent_idx && pos == act.pos;
+};
+template <>
+struct std::hash<Actions> {
+  inline size_t operator()(const Actions &acts) const noexcept{
+    ull val;
+    std::memcpy(&val, &acts, sizeof(val));
+    return val * 0x9E3779B97F4A7C15ULL;
   }
 };
 
@@ -38,13 +138,26 @@ struct Wall : Point {
 };
 
 
-using Actions = std::vector<Action>;
 using Agents = std::vector<Agent>;
 using Walls = std::vector<Wall>;
 
+// サーバーの盤面 (visualizerから届く正しい盤面)
+// codes[y*max_width+x] = 城壁(0:なし 1:味方 2:敵)*4 + 陣地(bit0:味方 bit1:敵)
+struct BoardSnapshot {
+  uchar codes[max_height * max_width] = {};
+  Agents ally_agents, enemy_agents;
+};
+
+// Field::update_field_kernelの処理の種類
+struct UpdateMode {
+  static constexpr int Apply = 0; // 盤面を更新する
+  static constexpr int ApplyAndFix = 1; // 盤面を更新し、失敗した行動をNoneにする
+  static constexpr int Check = 2; // 盤面は更新せず、全ての行動が成功するかだけを調べる
+};
+
 struct Field {
 
-  std::vector<std::vector<State>> field;
+  State cells[padded_size]; // 盤面 (to_cellの添字, 外周はState::Outside)
   Agents ally_agents, enemy_agents;
   std::vector<Point> castles;
   int side, current_turn, final_turn, TL;
@@ -57,8 +170,7 @@ struct Field {
         const int _side, // 0 or 1
         const int _final_turn,
         const int _TL)
-    : field(h, std::vector<State>(w, State::None)),
-      ally_agents(_ally_agents),
+    : ally_agents(_ally_agents),
       enemy_agents(_enemy_agents),
       castles(_castles),
       side(_side),
@@ -66,16 +178,19 @@ struct Field {
       final_turn(_final_turn),
       TL(_TL){
     assert(ally_agents.size() == enemy_agents.size()); // check
+    assert(h <= max_height && w <= max_width);
 
-    for(const auto &p : ponds) field[p.y][p.x] |= State::Pond;
-    for(const auto &p : castles) field[p.y][p.x] |= State::Castle;
-    for(const auto &p : ally_agents) field[p.y][p.x] |= State::Ally;
-    for(const auto &p : enemy_agents) field[p.y][p.x] |= State::Enemy;
+    std::fill(cells, cells + padded_size, State::Outside);
+    for(int i = 0; i < h; i++) std::fill(cells + to_cell(Point(i, 0)), cells + to_cell(Point(i, w)), State::None);
+    for(const auto &p : ponds) cells[to_cell(p)] |= State::Pond;
+    for(const auto &p : castles) cells[to_cell(p)] |= State::Castle;
+    for(const auto &p : ally_agents) cells[to_cell(p)] |= State::Ally;
+    for(const auto &p : enemy_agents) cells[to_cell(p)] |= State::Enemy;
   }
   
   inline State get_state(const int y, const int x) const noexcept{
     assert(is_valid(y, x));
-    return field[y][x];
+    return cells[to_cell(Point(y, x))];
   }
   inline State get_state(const Point &p) const noexcept{
     assert(is_valid(p.y, p.x));
@@ -83,383 +198,58 @@ struct Field {
   }
   inline void set_state(const int y, const int x, const State state) noexcept{
     assert(is_valid(y, x));
-    field[y][x] = state;
+    cells[to_cell(Point(y, x))] = state;
   }
   inline void set_state(const Point &p, const State state) noexcept{ set_state(p.y, p.x, state); }
+  // to_cellの添字で直接読み書きする (番兵も読める)
+  inline State get_cell(const int c) const noexcept{
+    assert(0 <= c && c < padded_size);
+    return cells[c];
+  }
+  inline void set_cell(const int c, const State state) noexcept{
+    assert(0 <= c && c < padded_size);
+    cells[c] = state;
+  }
 
   // スコア計算
   int calc_final_score() const{
-    int ally_walls = 0, enemy_walls = 0;
-    int ally_area = 0, enemy_area = 0;
-    int allys_castle = 0, enemys_castle = 0;
-    // 領域計算
-    for(int i = 0; i < height; i++){
-      for(int j = 0; j < width; j++){
-        const State s = get_state(i, j);
-        if(s & State::WallAlly) ally_walls++;
-        if(s & State::WallEnemy) enemy_walls++;
-        if(s & State::AreaAlly) ally_area++;
-        if(s & State::AreaEnemy) enemy_area++;
-        if(s & State::Castle){
-          if(s & State::AreaAlly) allys_castle++;
-          if(s & State::AreaEnemy) enemys_castle++;
-        }
-      }
-    }
-    const int score = (ally_walls-enemy_walls)*wall_coef + (ally_area-enemy_area)*area_coef + (allys_castle-enemys_castle)*castles_coef;
-    return score;
+    return with_board([&](auto board){ return calc_final_score<decltype(board)>(); });
+  }
+  template <class B>
+  int calc_final_score() const{
+    const auto count = Rules::count(cells, B());
+    return (count[1].points() - count[0].points()) / point_unit;
   }
 
   // 領地の更新
   void update_region(){
-    static constexpr uchar NotSeen = 0;
-    static constexpr uchar Area = 1;
-    static constexpr uchar Neutral = 2;
-
-    static std::queue<Point> que;
-
-    auto calc_region = [&](const State my_wall) -> std::vector<std::vector<uchar>> {
-      std::vector<std::vector<uchar>> used(height, std::vector<uchar>(width, NotSeen));
-
-      // fill Neutral
-      for(int i = 0; i < height; i++){
-        if(!(get_state(i, 0) & my_wall)){
-          que.push(Point(i, 0));
-          used[i][0] = Neutral;
-        }
-        if(!(get_state(i, width-1) & my_wall)){
-          que.push(Point(i, width-1));
-          used[i][width-1] = Neutral;
-        }
-      }
-      for(int j = 0; j < width; j++){
-        if(!(get_state(0, j) & my_wall)){
-          que.push(Point(0, j));
-          used[0][j] = Neutral;
-        }
-        if(!(get_state(height-1, j) & my_wall)){
-          que.push(Point(height-1, j));
-          used[height-1][j] = Neutral;
-        }
-      }
-      while(!que.empty()){
-        const Point pos = que.front();
-        que.pop();
-        for(int dir = 0; dir < 4; dir++){
-          const Point nxt = pos + dmove[dir];
-          if(!is_valid(nxt)) continue;
-          if(used[nxt.y][nxt.x] == NotSeen && !(get_state(nxt) & my_wall)){
-            used[nxt.y][nxt.x] = Neutral;
-            que.push(nxt);
-          }
-        }
-      }
-      // fill ally or enemy 's area
-      for(int i = 1; i < height-1; i++){
-        for(int j = 1; j < width-1; j++){
-          if(used[i][j] == NotSeen && !(get_state(i, j) & my_wall)){
-            used[i][j] = Area;
-          }
-        }
-      }
-      return used;
-    };
-
-    const auto ally_reg = calc_region(State::WallAlly);
-    const auto enemy_reg = calc_region(State::WallEnemy);
-    
-    // 片方囲われている -> 外された <-- そのまま
-    // 片方囲われている -> 片方に   <-- その片方に
-    // 両方囲われている -> 外された <-- そのまま(まだ不明)
-    // 両方囲われている -> 片方に   <-- その片方に
-    //           |
-    //           v
-    // 外されている -> そのまま
-    // 片方になる   -> その片方に
-    for(int i = 0; i < height; i++){
-      for(int j = 0; j < width; j++){
-        const State st = get_state(i, j);
-        if(ally_reg[i][j] == Area && enemy_reg[i][j] == Area){
-          set_state(i, j, st | State::Area);
-        }else if(ally_reg[i][j] == Area){
-          set_state(i, j, (st | State::AreaAlly) & ~State::AreaEnemy);
-        }else if(enemy_reg[i][j] == Area){
-          set_state(i, j, (st | State::AreaEnemy) & ~State::AreaAlly);
-        }
-        if(st & State::WallAlly) set_state(i, j, st & ~State::AreaAlly);
-        if(st & State::WallEnemy) set_state(i, j, st & ~State::AreaEnemy);
-      }
-    }
+    TRACE_SCOPE("update_region");
+    with_board([&](auto board){ update_region<decltype(board)>(); });
+  }
+  template <class B>
+  void update_region(){
+    Rules::update_territory(cells, B());
   }
 
   // side: 味方:0, 敵:1
   void update_field(const Actions &acts){
-    assert(acts.size() == ally_agents.size());
-    Actions act_list[4];
-    std::map<Point, int> agent_poses;
-
-    for(const auto &act : acts){
-      act_list[act.command].emplace_back(act);
-      assert(0 <= act.agent_idx && act.agent_idx < (int)acts.size());
-      if(act.command == Action::Move) agent_poses[act.pos]++;
-    }
-    
-    // ally turn
-    if(!(current_turn & 1) ^ side){
-      for(const Point agent : ally_agents) agent_poses[agent]++;
-      // break
-      for(const auto &act : act_list[Action::Break]){
-        const State st = get_state(act.pos);
-        if(!(st & State::Wall)){
-          cerr << "Error: there is not wall at(" << act.pos << ")\n";
-          continue;
-        }
-        set_state(act.pos, st & ~State::Wall);
-      }
-      // build
-      for(const auto &act : act_list[Action::Build]){
-        const State st = get_state(act.pos);
-        if(st & (State::WallEnemy | State::Enemy | State::Castle)){
-          cerr << "Error: there is wallenemy, enemy or castle at(" << act.pos << ")\n";
-          continue;
-        }
-        if(st & State::WallAlly){ // someone already built
-          cerr << "Error: someone has already built on(" << act.pos << ")\n";
-          continue;
-        }
-        set_state(act.pos, st | State::WallAlly);
-      }
-      // move
-      for(const auto &act : act_list[Action::Move]){
-        const State st = get_state(act.pos);
-        if(st & (State::Human | State::Pond | State::WallEnemy)){
-          cerr << "Error: there is human, pond or wallenemy at(" << act.pos << ")\n";
-          continue;
-        }
-        if(agent_poses[act.pos] >= 2){
-          cerr << "Error: many humans at(" << act.pos << ")\n";
-          continue;
-        }
-        const auto from = ally_agents[act.agent_idx];
-        set_state(from, get_state(from) ^ State::Ally);
-        set_state(act.pos, st | State::Ally);
-        ally_agents[act.agent_idx] = act.pos;
-      }
-    }
-    // enemy turn
-    else{
-      for(const Point agent : enemy_agents) agent_poses[agent]++;
-      // break
-      for(const auto &act : act_list[Action::Break]){
-        const State st = get_state(act.pos);
-        if(!(st & State::Wall)){
-          cerr << "Error: there is not wall at(" << act.pos << ")\n";
-          continue;
-        }
-        set_state(act.pos, st & ~State::Wall);
-      }
-      // build
-      for(const auto &act : act_list[Action::Build]){
-        const State st = get_state(act.pos);
-        if(st & (State::WallAlly | State::Ally | State::Castle)){
-          cerr << "Error: there is wallally, ally or castle at(" << act.pos << ")\n";
-          continue;
-        }
-        if(st & State::WallEnemy){ // someone already built
-          cerr << "Error: someone has already built on(" << act.pos << ")\n";
-          continue;
-        }
-        set_state(act.pos, st | State::WallEnemy);
-      }
-      // move
-      for(const auto &act : act_list[Action::Move]){
-        const State st = get_state(act.pos);
-        if(st & (State::Human | State::Pond | State::WallAlly)){
-          cerr << "Error: there is human, pond or wallally at(" << act.pos << ")\n";
-          continue;
-        }
-        if(agent_poses[act.pos] >= 2){
-          cerr << "Error: many humans at(" << act.pos << ")\n";
-          continue;
-        }
-        const auto from = enemy_agents[act.agent_idx];
-        set_state(from, get_state(from) ^ State::Enemy);
-        set_state(act.pos, st | State::Enemy);
-        enemy_agents[act.agent_idx] = act.pos;
-      }
-    }
+    if(!(current_turn & 1) ^ side) update_field_kernel<0, UpdateMode::Apply>(*this, acts);
+    else update_field_kernel<1, UpdateMode::Apply>(*this, acts);
     update_region();
   }
 
   // side: 味方:0, 敵:1
   void update_field_and_fix_actions(Actions &acts){
-    assert(acts.size() == ally_agents.size());
-    std::vector<Action*> act_list[4];
-    std::map<Point, int> agent_poses;
-
-    for(auto &act : acts){
-      act_list[act.command].emplace_back(&act);
-      assert(0 <= act.agent_idx && act.agent_idx < (int)acts.size());
-      if(act.command == Action::Move) agent_poses[act.pos]++;
-    }
-    
-    // ally turn
-    if(!(current_turn & 1) ^ side){
-      for(const Point agent : ally_agents) agent_poses[agent]++;
-      // break
-      for(auto *act : act_list[Action::Break]){
-        const State st = get_state(act->pos);
-        if(!(st & State::Wall)){
-          cerr << "Error: there is not wall at(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        set_state(act->pos, st & ~State::Wall);
-      }
-      // build
-      for(auto *act : act_list[Action::Build]){
-        const State st = get_state(act->pos);
-        if(st & (State::WallEnemy | State::Enemy | State::Castle)){
-          cerr << "Error: there is wallenemy, enemy or castle at(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        if(st & State::WallAlly){ // someone already built
-          cerr << "Error: someone has already built on(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        set_state(act->pos, st | State::WallAlly);
-      }
-      // move
-      for(auto *act : act_list[Action::Move]){
-        const State st = get_state(act->pos);
-        if(st & (State::Human | State::Pond | State::WallEnemy)){
-          cerr << "Error: there is human, pond or wallenemy at(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        if(agent_poses[act->pos] >= 2){
-          cerr << "Error: many humans at(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        const auto from = ally_agents[act->agent_idx];
-        set_state(from, get_state(from) ^ State::Ally);
-        set_state(act->pos, st | State::Ally);
-        ally_agents[act->agent_idx] = act->pos;
-      }
-    }
-    // enemy turn
-    else{
-      for(const Point agent : enemy_agents) agent_poses[agent]++;
-      // break
-      for(auto *act : act_list[Action::Break]){
-        const State st = get_state(act->pos);
-        if(!(st & State::Wall)){
-          cerr << "Error: there is not wall at(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        set_state(act->pos, st & ~State::Wall);
-      }
-      // build
-      for(auto *act : act_list[Action::Build]){
-        const State st = get_state(act->pos);
-        if(st & (State::WallAlly | State::Ally | State::Castle)){
-          cerr << "Error: there is wallally, ally or castle at(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        if(st & State::WallEnemy){ // someone already built
-          cerr << "Error: someone has already built on(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        set_state(act->pos, st | State::WallEnemy);
-      }
-      // move
-      for(auto *act : act_list[Action::Move]){
-        const State st = get_state(act->pos);
-        if(st & (State::Human | State::Pond | State::WallAlly)){
-          cerr << "Error: there is human, pond or wallally at(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        if(agent_poses[act->pos] >= 2){
-          cerr << "Error: many humans at(" << act->pos << ")\n";
-          act->command = Action::None;
-          continue;
-        }
-        const auto from = enemy_agents[act->agent_idx];
-        set_state(from, get_state(from) ^ State::Enemy);
-        set_state(act->pos, st | State::Enemy);
-        enemy_agents[act->agent_idx] = act->pos;
-      }
-    }
+    if(!(current_turn & 1) ^ side) update_field_kernel<0, UpdateMode::ApplyAndFix>(*this, acts);
+    else update_field_kernel<1, UpdateMode::ApplyAndFix>(*this, acts);
     update_region();
   }
 
   // s: 味方:0, 敵:1
   bool is_legal_action(const Actions &acts, int s = -1) const{
     if(s == -1) s = (current_turn & 1) ^ side;
-    assert(acts.size() == ally_agents.size());
-    Actions act_list[4];
-    std::map<Point, int> agent_poses;
-
-    for(const auto &act : acts){
-      act_list[act.command].emplace_back(act);
-      assert(0 <= act.agent_idx && act.agent_idx < (int)acts.size());
-      if(act.command == Action::Move) agent_poses[act.pos]++;
-    }
-    
-    // ally turn
-    if(!s){
-      for(const Point agent : ally_agents) agent_poses[agent]++;
-      // break
-      for(const auto &act : act_list[Action::Break]){
-        const State st = get_state(act.pos);
-        if(!(st & State::Wall)) return false;
-      }
-      // build
-      for(const auto &act : act_list[Action::Build]){
-        const State st = get_state(act.pos);
-        if(st & (State::WallEnemy | State::Enemy | State::Castle)) return false;
-        if(st & State::WallAlly){ // someone already built
-          continue;
-        }
-      }
-      // move
-      for(const auto &act : act_list[Action::Move]){
-        const State st = get_state(act.pos);
-        if(st & (State::Human | State::Pond | State::WallEnemy)) return false;
-        if(agent_poses[act.pos] >= 2) return false;
-      }
-    }
-    // enemy turn
-    else{
-      for(const Point agent : enemy_agents) agent_poses[agent]++;
-      // break
-      for(const auto &act : act_list[Action::Break]){
-        const State st = get_state(act.pos);
-        if(!(st & State::Wall)) return false;
-      }
-      // build
-      for(const auto &act : act_list[Action::Build]){
-        const State st = get_state(act.pos);
-        if(st & (State::WallAlly | State::Ally | State::Castle)) return false;
-        if(st & State::WallEnemy){ // someone already built
-          continue;
-        }
-      }
-      // move
-      for(const auto &act : act_list[Action::Move]){
-        const State st = get_state(act.pos);
-        if(st & (State::Human | State::Pond | State::WallAlly)) return false;
-        if(agent_poses[act.pos] >= 2) return false;
-      }
-    }
-    return true;
+    if(!s) return update_field_kernel<0, UpdateMode::Check>(*this, acts);
+    return update_field_kernel<1, UpdateMode::Check>(*this, acts);
   }
 
   void update_turn(const Actions &acts){
@@ -478,9 +268,38 @@ struct Field {
     if((current_turn & 1) ^ side) return enemy_agents;
     return ally_agents;
   }
+  // 城壁, 陣地, 職人の位置をサーバーの盤面に合わせる (行動の再計算はしない)
+  // 食い違っていたマスと職人の数を返す
+  int apply_snapshot(const BoardSnapshot &snap){
+    assert(snap.ally_agents.size() == ally_agents.size() && snap.enemy_agents.size() == enemy_agents.size());
+    int diff = 0;
+    for(int i = 0; i < (int)ally_agents.size(); i++) diff += !(ally_agents[i] == snap.ally_agents[i]);
+    for(int i = 0; i < (int)enemy_agents.size(); i++) diff += !(enemy_agents[i] == snap.enemy_agents[i]);
+    for(const Point p : ally_agents) cells[to_cell(p)] &= ~State::Ally;
+    for(const Point p : enemy_agents) cells[to_cell(p)] &= ~State::Enemy;
+    ally_agents = snap.ally_agents;
+    enemy_agents = snap.enemy_agents;
+    for(const Point p : ally_agents) cells[to_cell(p)] |= State::Ally;
+    for(const Point p : enemy_agents) cells[to_cell(p)] |= State::Enemy;
+
+    static constexpr State wall_states[] = { State::None, State::WallAlly, State::WallEnemy, State::None };
+    static constexpr State area_states[] = { State::None, State::AreaAlly, State::AreaEnemy, State::Area };
+    for(int i = 0; i < height; i++){
+      for(int j = 0; j < width; j++){
+        const int code = snap.codes[i * max_width + j];
+        State &st = cells[to_cell(Point(i, j))];
+        const State next = (st & ~(State::Wall | State::Area)) | wall_states[code >> 2] | area_states[code & 3];
+        diff += !(next == st);
+        st = next;
+      }
+    }
+    return diff;
+  }
   bool is_finished() const{ return current_turn == final_turn; }
   bool is_my_turn() const{ return (current_turn & 1) == side; }
+  // 盤面をcdebugに出力する (LOG_LEVELがDEBUG未満なら何もしない)
   void debug() const{
+    if constexpr(log_level < LOG_LEVEL_DEBUG) return;
     std::vector<std::string> board(height), wall(height), region(height);
     for(int i = 0; i < height; i++){
       for(int j = 0; j < width; j++){
@@ -508,11 +327,124 @@ struct Field {
         region[i] += c;
       }
     }
-    cerr << "board" << std::string(width-4, ' ') << ": walls" << std::string(width-4, ' ') << ": region\n";
+    cdebug << "board" << std::string(width-4, ' ') << ": walls" << std::string(width-4, ' ') << ": region\n";
     for(int i = 0; i < height; i++){
-      cerr << board[i] << " : " << wall[i] << " : " << region[i] << "\n";
+      cdebug << board[i] << " : " << wall[i] << " : " << region[i] << "\n";
+    }
+    cdebug << "\n";
+  }
+
+private:
+  // s: 味方:0, 敵:1
+  // 破壊 -> 建築 -> 移動 の順に処理し、全ての行動が成功したかを返す
+  // Selfがconst Fieldの場合はUpdateMode::Checkのみ
+  template <int s, int mode, class Self, class Acts>
+  static bool update_field_kernel(Self &self, Acts &acts){
+    static constexpr int team = 1 - s; // Rulesのチーム
+    static constexpr State enemy = State(Rules::mason(team ^ 1)); // sから見た敵
+    static constexpr State ally_wall = State(Rules::wall(team)); // sから見た味方のwall
+    auto &agents = s ? self.enemy_agents : self.ally_agents;
+    assert(acts.size() == (int)agents.size());
+
+    // 職人の現在地と移動先が重なったマスを調べる
+    static constexpr int bits_size = (max_height * max_width + 63) / 64;
+    ull occupied[bits_size] = {}, conflict[bits_size] = {};
+    const auto occupy = [&](const Point p){
+      const int idx = p.y * max_width + p.x;
+      const ull bit = 1ULL << (idx & 63);
+      conflict[idx >> 6] |= occupied[idx >> 6] & bit;
+      occupied[idx >> 6] |= bit;
+    };
+    for(const Point agent : agents) occupy(agent);
+    // 盤面の外への移動(Posは符号なしなので上端, 左端の外は255になる)はここでは数えず、下で失敗にする
+    for(const auto &act : acts){
+      assert(0 <= act.agent_idx() && act.agent_idx() < (int)acts.size());
+      if(act.command() != Action::Move) continue;
+      const Point pos = act.target(agents[act.agent_idx()]);
+      if(is_valid(pos)) occupy(pos);
+    }
+
+    bool ok = true;
+    // 失敗した行動の処理
+    const auto reject = [&](auto &act, const char *msg, const Point pos){
+      ok = false;
+      if constexpr(mode != UpdateMode::Check){
+        cerror << "Error: " << msg << " at(" << pos << ")\n";
+      }
+      if constexpr(mode == UpdateMode::ApplyAndFix){
+        act.set_command(Action::None);
+      }
+    };
+
+    // break
+    for(auto &act : acts){
+      if(act.command() != Action::Break) continue;
+      const Point pos = act.target(agents[act.agent_idx()]);
+      if(!is_valid(pos)){
+        reject(act, "out of field", pos);
+        if constexpr(mode == UpdateMode::Check) return false;
+        continue;
+      }
+      const State st = self.get_state(pos);
+      if(!(st & State(Rules::break_target))){
+        reject(act, "there is not wall", pos);
+        if constexpr(mode == UpdateMode::Check) return false;
+        continue;
+      }
+      if constexpr(mode != UpdateMode::Check) self.set_state(pos, st & ~State::Wall);
+    }
+    // build
+    for(auto &act : acts){
+      if(act.command() != Action::Build) continue;
+      const Point pos = act.target(agents[act.agent_idx()]);
+      if(!is_valid(pos)){
+        reject(act, "out of field", pos);
+        if constexpr(mode == UpdateMode::Check) return false;
+        continue;
+      }
+      const State st = self.get_state(pos);
+      if(st & State(Rules::build_blocker(team))){
+        reject(act, s ? "there is wallally, ally or castle" : "there is wallenemy, enemy or castle", pos);
+        if constexpr(mode == UpdateMode::Check) return false;
+        continue;
+      }
+      if(st & ally_wall){ // someone already built
+        if constexpr(mode == UpdateMode::Check) continue;
+        reject(act, "someone has already built on", pos);
+        continue;
+      }
+      if constexpr(mode != UpdateMode::Check) self.set_state(pos, st | ally_wall);
+    }
+    // move
+    for(auto &act : acts){
+      if(act.command() != Action::Move) continue;
+      const Point pos = act.target(agents[act.agent_idx()]);
+      if(!is_valid(pos)){
+        reject(act, "out of field", pos);
+        if constexpr(mode == UpdateMode::Check) return false;
+        continue;
+      }
+      const State st = self.get_state(pos);
+      if(st & State(Rules::move_blocker(team))){
+        reject(act, s ? "there is human, pond or wallally" : "there is human, pond or wallenemy", pos);
+        if constexpr(mode == UpdateMode::Check) return false;
+        continue;
+      }
+      const int idx = pos.y * max_width + pos.x;
+      if(conflict[idx >> 6] >> (idx & 63) & 1){
+        reject(act, "many humans", pos);
+        if constexpr(mode == UpdateMode::Check) return false;
+        continue;
+      }
+      if constexpr(mode != UpdateMode::Check){
+        static constexpr State ally = enemy ^ State::Human;
+        const Point from = agents[act.agent_idx()];
+        self.set_state(from, self.get_state(from) ^ ally);
+        self.set_state(pos, st | ally);
+        agents[act.agent_idx()] = pos;
+      }
     }
-    cerr << "\n";
+    return ok;
   }
 };
 
@@ -527,6 +459,7 @@ Field read_field(const int h, const int w){
     return res;
   };
 
+  set_board_size(h, w);
   int side; // 先行:0,後攻:1
   int final_turn, TL;
   std::cin >> side >> final_turn >> TL;
@@ -547,3 +480,46 @@ Field read_field(const int h, const int w){
     TL
   );
 }
+
+
+// visualizer/App/field/*.csv形式の盤面を読み込む
+// 0:なし, 1:池, 2:城, a:先攻の職人, b:後攻の職人
+// height, widthもここで設定される
+Field read_field_csv(const std::string &path, const int side, const int final_turn, const int TL){
+  std::ifstream is(path);
+  assert(is);
+  std::vector<Point> ponds, castles;
+  Agents ally_agents, enemy_agents;
+  std::string line;
+  int h = 0, w = 0;
+  while(std::getline(is, line)){
+    std::stringstream ss(line);
+    std::string cell;
+    int x = 0;
+    while(std::getline(ss, cell, ',')){
+      if(cell.empty()) continue;
+      const char c = cell[0];
+      if(c == '1') ponds.emplace_back(h, x);
+      else if(c == '2') castles.emplace_back(h, x);
+      else if(c == 'a') (side ? enemy_agents : ally_agents).emplace_back(h, x);
+      else if(c == 'b') (side ? ally_agents : enemy_agents).emplace_back(h, x);
+      x++;
+    }
+    if(!x) continue;
+    assert(!w || w == x);
+    w = x;
+    h++;
+  }
+  assert(h <= max_height && w <= max_width);
+  set_board_size(h, w);
+  return Field(
+    h, w,
+    ponds,
+    castles,
+    ally_agents,
+    enemy_agents,
+    side,
+    final_turn,
+    TL
+  );
+}
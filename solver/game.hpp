@@ -0,0 +1,188 @@
+#pragma once
+
+// 1試合分のsolverの状態と1ターンの処理
+// 入出力の方法によらない部分で、computer.cpp(visualizerとの標準入出力)とclient.cpp(試合サーバー)で共有する
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include "base.hpp"
+#include "tsp.hpp"
+#include "telemetry.hpp"
+#include "protocol.hpp"
+
+struct Game {
+  Field field;
+  Walls build_walls;
+  BoardSnapshot snapshot; // 最後に届いたサーバーの盤面
+  TimeManager time_manager;
+  Telemetry telemetry;
+  // 自分の行動を出力する (Watchdogのスレッドから呼ばれることもある)
+  const std::function<void(const Actions&)> output;
+  // 探索途中の暫定の行動を出力する (空なら出力しない)
+  // 探索のスレッドを止めないように、runの間だけ起動する送信用のスレッドから呼ばれる
+  // 最終的な行動の出力はこれを待たないので、出力を始めた時点で送信中だった1回だけはoutputと同時に呼ばれうる
+  // 出力先を共有する場合は書き込みを直列にし、それが最終的な行動より後に届かないようにすること
+  std::function<void(const Actions&)> progress;
+  static constexpr double progress_interval_ms = 100; // 暫定の行動を出力する最小の間隔 (出力先があふれないように)
+  // 自分のターンの探索の様子を出力する (空なら出力しない, 最終的な行動の出力より後に呼ばれる)
+  std::function<void(const Protocol::TurnInsight&)> insight;
+  Game(const Field &f, std::function<void(const Actions&)> _output) : field(f), time_manager(f.TL), output(std::move(_output)){
+    time_manager.start_turn();
+  }
+
+  void run(){ run(time_manager.deadline()); }
+  // deadlineまでに最終的な行動を出力する
+  void run(const Deadline &deadline){
+    TRACE_SCOPE("Game::run");
+    alloc_turn_begin();
+    assert(field.is_my_turn());
+    const auto &current_agents = field.get_now_turn_agents();
+    const int m = current_agents.size();
+    cerr << "run\n";
+
+    // 暫定の最善手 (Actionsは8byteなのでそのままatomicにできる)
+    Actions fallback;
+    for(int i = 0; i < m; i++) fallback.emplace_back(Action(Action::None, 0, i));
+    std::atomic<Actions> best(fallback);
+    TurnRecord record;
+    // 暫定の行動は最新のものだけをslotに置き、送信用のスレッドが出力する
+    // 最終的な行動の出力は送信中の暫定の行動を待たない
+    std::mutex slot_mtx;
+    std::condition_variable slot_cv;
+    Actions slot;
+    bool slot_full = false, output_done = false;
+    const auto output_final = [&](const Actions &acts){
+      {
+        std::lock_guard<std::mutex> lock(slot_mtx);
+        output_done = true;
+      }
+      slot_cv.notify_one();
+      output(acts);
+    };
+    std::thread sender;
+    if(progress){
+      sender = std::thread([&]{
+        std::unique_lock<std::mutex> lock(slot_mtx);
+        while(true){
+          slot_cv.wait(lock, [&]{ return slot_full || output_done; });
+          if(output_done) return;
+          const Actions acts = slot;
+          slot_full = false;
+          record.plans++;
+          lock.unlock();
+          progress(acts);
+          lock.lock();
+        }
+      });
+    }
+    Actions last_progress;
+    StopWatch progress_sw;
+    SearchContext ctx(deadline);
+    ctx.emit = [&](const Actions &acts){
+      best.store(acts);
+      // 変わったときだけ、間隔を空けて出力する
+      if(!progress || acts == last_progress) return;
+      if(!last_progress.empty() && progress_sw.get_ms() < progress_interval_ms) return;
+      {
+        std::lock_guard<std::mutex> lock(slot_mtx);
+        if(output_done) return;
+        slot = acts;
+        slot_full = true;
+      }
+      slot_cv.notify_one();
+      last_progress = acts;
+      progress_sw.reset();
+    };
+    record.turn = field.current_turn;
+    record.soft_ms = elapsed_ms(ctx.deadline.start, ctx.deadline.soft);
+    record.hard_ms = elapsed_ms(ctx.deadline.start, ctx.deadline.hard);
+    ctx.stats = &record.search;
+    std::vector<Walls> routes;
+    if(insight) ctx.routes = &routes;
+
+    Actions res;
+    bool timeout = false;
+    {
+      // 出力の期限を過ぎたら暫定の最善手をそのまま出力する
+      Watchdog watchdog(ctx.deadline.hard, [&]{
+        TRACE_SCOPE("Watchdog::output");
+        output_final(best.load());
+      });
+      res = calculate_build_route(build_walls, field, ctx);
+      time_manager.end_search();
+      assert(res.size() == m);
+      if(watchdog.claim()){
+        field.update_turn_and_fix_actions(res);
+        output_final(res);
+      }else{
+        timeout = true;
+      }
+    }
+    record.elapsed_ms = time_manager.turn_elapsed_ms();
+    // 最終的な行動は出力済みなので、送信中の暫定の行動が終わるのを待ってよい
+    if(sender.joinable()) sender.join();
+    if(timeout){
+      res = best.load();
+      cerr << "Timeout: output the best actions so far\n";
+      field.update_turn_and_fix_actions(res);
+    }
+    time_manager.end_turn();
+
+    record.timeout = timeout;
+    record.score = field.calc_final_score();
+    record.eval = Evaluate::evaluate_field(field);
+    telemetry.write(record);
+    if(insight) insight(make_insight(record, routes));
+    alloc_turn_end(record.turn);
+
+    field.debug();
+    cerr << "my turn\n";
+    for(int i = 0; i < m; i++){
+      assert(i == res[i].agent_idx());
+      cerr << res[i].dir() << " " << Protocol::command_names[res[i].command()] << "\n";
+    }
+  }
+
+  // 行動後の盤面で、routesの壁を全て建てたときの味方の陣地を予測する
+  Protocol::TurnInsight make_insight(const TurnRecord &record, std::vector<Walls> routes) const{
+    Protocol::TurnInsight res;
+    res.turn = record.turn;
+    res.elapsed_ms = record.elapsed_ms;
+    res.limit_ms = record.hard_ms;
+    res.sa_steps = record.search.sa_steps;
+    res.best_cost = record.search.final_cost;
+    res.score = record.score;
+    Field future = field;
+    for(const Walls &route : routes){
+      for(const Wall p : route){
+        const State st = future.get_state(p);
+        if(!(st & (State::WallEnemy | State::Castle))) future.set_state(p, st | State::WallAlly);
+      }
+    }
+    future.update_region();
+    for(int y = 0; y < height; y++){
+      for(int x = 0; x < width; x++){
+        if(future.get_state(y, x) & State::AreaAlly) res.territory.emplace_back(y, x);
+      }
+    }
+    res.routes = std::move(routes);
+    return res;
+  }
+
+  // 相手のターンの行動を反映し、resyncならsnapshotに合わせる
+  void update_enemy_turn(const Actions &res, const bool resync){
+    assert(!field.is_my_turn());
+    cerr << "enemy turn\n";
+    for(const auto &act : res){
+      cerr << act.dir() << " " << Protocol::command_names[act.command()] << "\n";
+    }
+    field.update_turn(res);
+    if(resync){
+      const int diff = field.apply_snapshot(snapshot);
+      if(diff) cerr << "Resync: " << diff << " cells/agents differed from the server\n";
+    }
+    field.debug();
+  }
+};
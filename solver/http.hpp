@@ -0,0 +1,254 @@
+#pragma once
+
+// 試合サーバーとの通信に使う最小限のHTTP/1.1
+// 1本のTCP接続をkeep-aliveで使い回し、切れていたら1度だけ繋ぎ直して送り直す
+// client.cpp(クライアント)とreplay_server.cpp(ローカルのサーバーの代わり)で共有する
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#ifdef _WIN32
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #pragma comment(lib, "ws2_32.lib")
+#else
+  #include <netdb.h>
+  #include <unistd.h>
+  #include <sys/socket.h>
+  #include <sys/time.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+#endif
+#include "lib.hpp"
+
+namespace Net {
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+constexpr socket_t invalid_socket = INVALID_SOCKET;
+inline void close_socket(const socket_t s){ closesocket(s); }
+struct WinsockInit {
+  WinsockInit(){ WSADATA data; WSAStartup(MAKEWORD(2, 2), &data); }
+  ~WinsockInit(){ WSACleanup(); }
+};
+inline WinsockInit winsock_init;
+#else
+using socket_t = int;
+constexpr socket_t invalid_socket = -1;
+inline void close_socket(const socket_t s){ ::close(s); }
+#endif
+
+#ifdef MSG_NOSIGNAL
+constexpr int send_flags = MSG_NOSIGNAL; // 切れた接続に書いてもSIGPIPEで落ちないようにする
+#else
+constexpr int send_flags = 0;
+#endif
+
+// 小さいリクエストをすぐ送るためにNagleを切り、応答が来ない場合はtimeout_ms で諦める
+inline void set_socket_options(const socket_t s, const int timeout_ms){
+  const int one = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+#ifdef _WIN32
+  const DWORD tv = timeout_ms;
+#else
+  timeval tv;
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = timeout_ms % 1000 * 1000;
+#endif
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+}
+
+inline socket_t connect_tcp(const std::string &host, const int port, const int timeout_ms){
+  addrinfo hints = {}, *res = nullptr;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if(getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0) return invalid_socket;
+  socket_t s = invalid_socket;
+  for(addrinfo *ai = res; ai; ai = ai->ai_next){
+    s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if(s == invalid_socket) continue;
+    if(connect(s, ai->ai_addr, ai->ai_addrlen) == 0) break;
+    close_socket(s);
+    s = invalid_socket;
+  }
+  freeaddrinfo(res);
+  if(s != invalid_socket) set_socket_options(s, timeout_ms);
+  return s;
+}
+
+inline socket_t listen_tcp(const int port){
+  const socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+  if(s == invalid_socket) return s;
+  const int one = 1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if(bind(s, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, 4) != 0){
+    close_socket(s);
+    return invalid_socket;
+  }
+  return s;
+}
+
+inline bool send_all(const socket_t s, const std::string &data){
+  size_t sent = 0;
+  while(sent < data.size()){
+    const int n = send(s, data.data() + sent, data.size() - sent, send_flags);
+    if(n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+} // namespace Net
+
+
+// 1本の接続の上でHTTPメッセージを読む (ヘッダー + Content-Lengthかchunkedの本文)
+struct HttpStream {
+  Net::socket_t sock = Net::invalid_socket;
+
+  void reset(const Net::socket_t s){
+    sock = s;
+    buf.clear();
+    pos = 0;
+  }
+  bool read_line(std::string &line){
+    while(true){
+      const size_t end = buf.find("\r\n", pos);
+      if(end != std::string::npos){
+        line.assign(buf, pos, end - pos);
+        pos = end + 2;
+        return true;
+      }
+      if(!fill()) return false;
+    }
+  }
+  // ヘッダーを読み、header(name)の値を返せるようにする. 最初の行はstart_lineに入る
+  bool read_head(std::string &start_line){
+    headers.clear();
+    do{
+      if(!read_line(start_line)) return false;
+    }while(start_line.empty());
+    std::string line;
+    while(read_line(line) && !line.empty()){
+      const size_t colon = line.find(':');
+      if(colon == std::string::npos) continue;
+      std::string name = line.substr(0, colon);
+      for(char &c : name) c = std::tolower((uchar)c);
+      size_t v = colon + 1;
+      while(v < line.size() && line[v] == ' ') v++;
+      headers.emplace_back(name, line.substr(v));
+    }
+    return line.empty();
+  }
+  std::string header(const std::string &name) const{
+    for(const auto &[k, v] : headers){
+      if(k == name) return v;
+    }
+    return "";
+  }
+  // 長さの無い本文を接続が閉じるまで読むのは応答だけ (リクエストなら本文なし)
+  bool read_body(std::string &body, const bool is_response = true){
+    body.clear();
+    if(header("transfer-encoding").find("chunked") != std::string::npos){
+      std::string line;
+      while(true){
+        if(!read_line(line)) return false;
+        const size_t n = std::strtoul(line.c_str(), nullptr, 16);
+        if(n == 0) break;
+        if(!read_n(n, body) || !read_line(line)) return false;
+      }
+      while(read_line(line) && !line.empty()); // trailer
+      return true;
+    }
+    const std::string len = header("content-length");
+    if(!len.empty()) return read_n(std::strtoul(len.c_str(), nullptr, 10), body);
+    if(!is_response) return true;
+    while(fill());
+    body.assign(buf, pos, std::string::npos);
+    pos = buf.size();
+    return true;
+  }
+
+private:
+  std::string buf;
+  size_t pos = 0;
+  std::vector<std::pair<std::string, std::string>> headers;
+
+  bool fill(){
+    if(pos > 0 && pos == buf.size()){
+      buf.clear();
+      pos = 0;
+    }
+    char tmp[1 << 14];
+    const int n = recv(sock, tmp, sizeof(tmp), 0);
+    if(n <= 0) return false;
+    buf.append(tmp, n);
+    return true;
+  }
+  bool read_n(const size_t n, std::string &out){
+    while(buf.size() - pos < n){
+      if(!fill()) return false;
+    }
+    out.append(buf, pos, n);
+    pos += n;
+    return true;
+  }
+};
+
+struct HttpResponse {
+  int status = 0;
+  std::string body;
+};
+
+struct HttpClient {
+  HttpClient(const std::string &_host, const int _port, const int _timeout_ms = 3000)
+    : host(_host), port(_port), timeout_ms(_timeout_ms){}
+  ~HttpClient(){ disconnect(); }
+  HttpClient(const HttpClient&) = delete;
+  HttpClient &operator=(const HttpClient&) = delete;
+
+  bool get(const std::string &path, HttpResponse &res){ return request("GET", path, "", res); }
+  bool post(const std::string &path, const std::string &body, HttpResponse &res){ return request("POST", path, body, res); }
+
+private:
+  const std::string host;
+  const int port, timeout_ms;
+  HttpStream stream;
+
+  void disconnect(){
+    if(stream.sock != Net::invalid_socket) Net::close_socket(stream.sock);
+    stream.reset(Net::invalid_socket);
+  }
+  bool request(const char *method, const std::string &path, const std::string &body, HttpResponse &res){
+    std::string req = std::string(method) + " " + path + " HTTP/1.1\r\n"
+                      "Host: " + host + ":" + std::to_string(port) + "\r\n"
+                      "Connection: keep-alive\r\n"
+                      "Content-Type: application/json\r\n";
+    if(!body.empty() || std::strcmp(method, "POST") == 0) req += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    req += "\r\n";
+    req += body;
+    // 使い回した接続がサーバー側で閉じられていた場合だけ繋ぎ直す
+    for(int attempt = 0; attempt < 2; attempt++){
+      const bool reused = stream.sock != Net::invalid_socket;
+      if(!reused){
+        const Net::socket_t s = Net::connect_tcp(host, port, timeout_ms);
+        if(s == Net::invalid_socket) return false;
+        stream.reset(s);
+      }
+      std::string status_line;
+      if(Net::send_all(stream.sock, req) && stream.read_head(status_line) && stream.read_body(res.body)){
+        const size_t sp = status_line.find(' ');
+        res.status = sp == std::string::npos ? 0 : std::atoi(status_line.c_str() + sp + 1);
+        if(stream.header("connection") == "close") disconnect();
+        return true;
+      }
+      disconnect();
+      if(!reused) return false;
+    }
+    return false;
+  }
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+// 試合サーバーとのやり取りに使う最小限のJSON
+// 数値はdouble, オブジェクトはキーの順番を保ったまま持つ
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdlib>
+#include <cctype>
+#include "lib.hpp"
+
+struct Json {
+  static constexpr uchar Null = 0;
+  static constexpr uchar Bool = 1;
+  static constexpr uchar Number = 2;
+  static constexpr uchar String = 3;
+  static constexpr uchar Array = 4;
+  static constexpr uchar Object = 5;
+
+  uchar type = Null;
+  bool boolean = false;
+  double number = 0;
+  std::string str;
+  std::vector<std::string> keys; // Objectのキー (itemsと同じ順)
+  std::vector<Json> items; // Arrayの要素, Objectの値
+
+  // 失敗したらfalse (outの中身は不定)
+  static bool parse(const std::string_view text, Json &out){
+    Parser p{ text, 0 };
+    if(!p.value(out)) return false;
+    p.skip_ws();
+    return p.pos == text.size();
+  }
+
+  // 無いキー, 範囲外はNullを返す
+  const Json &operator[](const std::string_view key) const{
+    for(int i = 0; i < (int)keys.size(); i++){
+      if(keys[i] == key) return items[i];
+    }
+    return null_json();
+  }
+  const Json &operator[](const int i) const{
+    if(type != Array || i < 0 || i >= (int)items.size()) return null_json();
+    return items[i];
+  }
+  int size() const{ return items.size(); }
+  bool is_null() const{ return type == Null; }
+  int get_int(const int def = 0) const{ return type == Number ? (int)number : def; }
+  bool get_bool(const bool def = false) const{ return type == Bool ? boolean : def; }
+  const std::string &get_string() const{ return str; }
+
+private:
+  static const Json &null_json(){
+    static const Json null;
+    return null;
+  }
+
+  struct Parser {
+    std::string_view s;
+    size_t pos;
+
+    void skip_ws(){
+      while(pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r')) pos++;
+    }
+    bool consume(const std::string_view word){
+      if(s.substr(pos, word.size()) != word) return false;
+      pos += word.size();
+      return true;
+    }
+    bool value(Json &v){
+      skip_ws();
+      if(pos == s.size()) return false;
+      const char c = s[pos];
+      if(c == '{') return object(v);
+      if(c == '[') return array(v);
+      if(c == '"'){
+        v.type = String;
+        return string(v.str);
+      }
+      if(consume("true")){ v.type = Bool; v.boolean = true; return true; }
+      if(consume("false")){ v.type = Bool; v.boolean = false; return true; }
+      if(consume("null")){ v.type = Null; return true; }
+      return number(v);
+    }
+    bool number(Json &v){
+      // string_viewは終端されていないので、数値の部分だけコピーしてstrtodに渡す
+      const size_t begin = pos;
+      while(pos < s.size() && (std::isdigit((uchar)s[pos]) || s[pos] == '-' || s[pos] == '+' || s[pos] == '.' || s[pos] == 'e' || s[pos] == 'E')) pos++;
+      if(begin == pos) return false;
+      const std::string num(s.substr(begin, pos - begin));
+      char *end;
+      v.type = Number;
+      v.number = std::strtod(num.c_str(), &end);
+      return *end == '\0';
+    }
+    bool string(std::string &out){
+      pos++; // "
+      out.clear();
+      while(pos < s.size() && s[pos] != '"'){
+        char c = s[pos++];
+        if(c == '\\'){
+          if(pos == s.size()) return false;
+          c = s[pos++];
+          if(c == 'n') c = '\n';
+          else if(c == 't') c = '\t';
+          else if(c == 'r') c = '\r';
+          else if(c == 'b') c = '\b';
+          else if(c == 'f') c = '\f';
+          else if(c == 'u'){ // サーバーはASCIIしか返さないので、BMPの文字だけUTF-8にする
+            if(pos + 4 > s.size()) return false;
+            const int code = std::strtol(std::string(s.substr(pos, 4)).c_str(), nullptr, 16);
+            pos += 4;
+            if(code < 0x80) c = code;
+            else if(code < 0x800){
+              out += (char)(0xC0 | code >> 6);
+              c = 0x80 | (code & 0x3F);
+            }else{
+              out += (char)(0xE0 | code >> 12);
+              out += (char)(0x80 | (code >> 6 & 0x3F));
+              c = 0x80 | (code & 0x3F);
+            }
+          }
+        }
+        out += c;
+      }
+      if(pos == s.size()) return false;
+      pos++; // "
+      return true;
+    }
+    bool array(Json &v){
+      pos++; // [
+      v.type = Array;
+      skip_ws();
+      if(consume("]")) return true;
+      while(true){
+        v.items.emplace_back();
+        if(!value(v.items.back())) return false;
+        skip_ws();
+        if(consume("]")) return true;
+        if(!consume(",")) return false;
+      }
+    }
+    bool object(Json &v){
+      pos++; // {
+      v.type = Object;
+      skip_ws();
+      if(consume("}")) return true;
+      while(true){
+        skip_ws();
+        if(pos == s.size() || s[pos] != '"') return false;
+        v.keys.emplace_back();
+        if(!string(v.keys.back())) return false;
+        skip_ws();
+        if(!consume(":")) return false;
+        v.items.emplace_back();
+        if(!value(v.items.back())) return false;
+        skip_ws();
+        if(consume("}")) return true;
+        if(!consume(",")) return false;
+      }
+    }
+  };
+};
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <algorithm>
 #include <cstdint>
+#include "rules.hpp"
 
 using uchar = unsigned char;
 using uint = unsigned int;
@@ -11,10 +12,38 @@ using ull = unsigned long long;
 using ll = long long;
 using Pos = uint8_t; // y,x座標の型
 
-constexpr int max_height = 25;
-constexpr int max_width = 25;
+// 32bitの立っているbitの数と、最下位の立っているbitの位置 (ctz32はx != 0のときだけ)
+// GCC/Clangは組み込み関数, MSVC(solver_lib.cppをvisualizerに組み込む場合)はstd::popcountと_BitScanForward
+#ifdef _MSC_VER
+  #include <intrin.h>
+  #if _MSVC_LANG >= 202002L
+    #include <bit>
+  #endif
+inline constexpr int popcount32(const uint x) noexcept{
+  #if _MSVC_LANG >= 202002L
+  return std::popcount(x);
+  #else
+  int c = 0;
+  for(uint v = x; v; v &= v - 1) c++;
+  return c;
+  #endif
+}
+inline int ctz32(const uint x) noexcept{
+  unsigned long i = 0;
+  _BitScanForward(&i, x);
+  return (int)i;
+}
+#else
+inline constexpr int popcount32(const uint x) noexcept{ return __builtin_popcount(x); }
+inline int ctz32(const uint x) noexcept{ return __builtin_ctz(x); }
+#endif
+
+constexpr int max_height = Rules::max_height;
+constexpr int max_width = Rules::max_width;
 constexpr int max_agent_num = 6;
-constexpr int castles_coef = 10, area_coef = 3, wall_coef = 1;
+// 評価に使う得点は公式の得点(Rules)の1/point_unit
+constexpr int point_unit = 10;
+constexpr int castles_coef = Rules::castle_point / point_unit, area_coef = Rules::area_point / point_unit, wall_coef = Rules::wall_point / point_unit;
 
 constexpr Pos dy[] = { (Pos)-1,0,1,0, (Pos)-1,1,1,(Pos)-1 };
 constexpr Pos dx[] = { 0,(Pos)-1,0,1, (Pos)-1,(Pos)-1,1,1 };
@@ -22,23 +51,149 @@ constexpr Pos dx[] = { 0,(Pos)-1,0,1, (Pos)-1,(Pos)-1,1,1 };
 int height = 0, width = 0; // fieldの大きさ
 
 // error出力
+// 書き込みはリングバッファへのコピーだけで、ファイルへの書き出しは別スレッドで行う
+// ログレベルはコンパイル時に決まり、LOG_LEVELより詳細なログは何もしない
+#include <cstdio>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <charconv>
+#include <sstream>
+#include <string_view>
+#include <type_traits>
+
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+#ifndef LOG_LEVEL
+  #ifdef NDEBUG
+    #define LOG_LEVEL LOG_LEVEL_INFO
+  #else
+    #define LOG_LEVEL LOG_LEVEL_DEBUG
+  #endif
+#endif
+constexpr int log_level = LOG_LEVEL;
+
 #ifndef NOERRFILE
-  #include <fstream>
-  struct Cerr {
-    Cerr(const std::string &filename) : os(filename){}
-    template <class T>
-    inline Cerr &operator<<(const T &val) noexcept{
-      os << val << std::flush;
-      return *this;
+  #ifndef ERRFILE
+    #define ERRFILE "stderr.txt"
+  #endif
+#endif
+
+// 探索のスレッド, 期限を見張るスレッドなど複数のスレッドから書き込む (multi-producer)
+// writeは書き込む範囲をreserve_posのCASで予約してコピーし、先に予約したwriteが公開されるのを待ってからwrite_posを進めて公開する
+// flushはwrite_posまでしか読まないので、コピーの途中の範囲を書き出すことはない
+// (writeの単位では混ざらないが、<<で続けて書いたものの間に他のスレッドの書き込みが入ることはある)
+// バッファが一杯の場合は書き込まずに捨て、捨てたバイト数を後で出力する
+struct Logger {
+  static constexpr size_t capacity = 1 << 20;
+
+  explicit Logger(const char *path) : path(path){}
+  ~Logger(){
+    if(writer.joinable()){
+      stop = true;
+      writer.join();
+    }
+    flush();
+    if(fp && fp != stderr) std::fclose(fp);
+  }
+
+  void write(const char *s, const size_t n) noexcept{
+    if(!started.load(std::memory_order_relaxed)) start();
+    size_t w = reserve_pos.load(std::memory_order_relaxed);
+    do{
+      if(w + n - read_pos.load(std::memory_order_acquire) > capacity){
+        dropped.fetch_add(n, std::memory_order_relaxed);
+        return;
+      }
+    }while(!reserve_pos.compare_exchange_weak(w, w + n, std::memory_order_relaxed));
+    const size_t i = w % capacity;
+    const size_t k = std::min(n, capacity - i);
+    std::copy(s, s + k, buf + i);
+    std::copy(s + k, s + n, buf);
+    // 予約した順に公開する (前のwriteはコピーするだけなので待つのは短い)
+    while(write_pos.load(std::memory_order_acquire) != w) std::this_thread::yield();
+    write_pos.store(w + n, std::memory_order_release);
+  }
+  // バッファの内容を呼び出したスレッドで書き出す
+  void flush() noexcept{
+    std::lock_guard<std::mutex> lock(drain_mtx);
+    if(!fp) return;
+    const size_t r = read_pos.load(std::memory_order_relaxed);
+    const size_t w = write_pos.load(std::memory_order_acquire);
+    if(r == w && !dropped.load(std::memory_order_relaxed)) return;
+    const size_t i = r % capacity;
+    const size_t k = std::min(w - r, capacity - i);
+    std::fwrite(buf + i, 1, k, fp);
+    std::fwrite(buf, 1, w - r - k, fp);
+    read_pos.store(w, std::memory_order_release);
+    if(const size_t d = dropped.exchange(0, std::memory_order_relaxed)){
+      std::fprintf(fp, "[log] dropped %zu bytes\n", d);
     }
-  private:
-    std::ofstream os;
-  };
-  Cerr cerr("stderr.txt");
+    std::fflush(fp);
+  }
+
+private:
+  // 最初の書き込みでファイルを開き、書き出し用のスレッドを起動する
+  // (fork後の子プロセスで初めて書き込んだ場合もそこで起動する)
+  void start() noexcept{
+    std::lock_guard<std::mutex> lock(drain_mtx);
+    if(started.load(std::memory_order_relaxed)) return;
+    fp = path ? std::fopen(path, "w") : stderr;
+    writer = std::thread([this]{
+      while(!stop){
+        flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      }
+    });
+    started.store(true, std::memory_order_relaxed);
+  }
+
+  const char *path;
+  std::FILE *fp = nullptr;
+  char buf[capacity];
+  std::atomic<size_t> reserve_pos{0}, write_pos{0}, read_pos{0}, dropped{0};
+  std::atomic<bool> started{false}, stop{false};
+  std::mutex drain_mtx;
+  std::thread writer;
+};
+#ifndef NOERRFILE
+  Logger logger(ERRFILE);
 #else
-  using std::cerr;
+  Logger logger(nullptr);
 #endif
 
+// cerr << ... の形で書く, levelがLOG_LEVELより詳細なら何もしない
+template <int level>
+struct LogStream {
+  template <class T>
+  inline LogStream &operator<<(const T &val) noexcept{
+    if constexpr(level <= log_level){
+      if constexpr(std::is_convertible_v<const T&, std::string_view>){
+        const std::string_view str = val;
+        logger.write(str.data(), str.size());
+      }else if constexpr(std::is_same_v<T, char>){
+        logger.write(&val, 1);
+      }else if constexpr(std::is_integral_v<T> && sizeof(T) > 1){
+        char str[24];
+        const auto res = std::to_chars(str, str + sizeof(str), val);
+        logger.write(str, res.ptr - str);
+      }else{
+        thread_local std::ostringstream os;
+        os.str("");
+        os << val;
+        const std::string str = os.str();
+        logger.write(str.data(), str.size());
+      }
+    }
+    return *this;
+  }
+};
+LogStream<LOG_LEVEL_ERROR> cerror;
+LogStream<LOG_LEVEL_INFO> cerr;
+LogStream<LOG_LEVEL_DEBUG> cdebug;
+
 
 // stacktrace/
 #include <sstream>
@@ -89,7 +244,8 @@ std::string get_backtrace_info(){
 
 void _assertion_failed(char const *expr){
   const auto info = get_backtrace_info();
-  cerr << "Expression '" << expr << "' is false in\n" << info << "\n";
+  cerror << "Expression '" << expr << "' is false in\n" << info << "\n";
+  logger.flush(); // abortの前にバッファを書き出す
   std::abort();
 }
 
@@ -97,7 +253,7 @@ void _assertion_failed(char const *expr){
   #define assert(expr) \
   (void) \
   ((!!(expr)) || \
-  (cerr << "Assertion Failed!!! " << __FILE__ << ", " << __LINE__ << "\n", \
+  (cerror << "Assertion Failed!!! " << __FILE__ << ", " << __LINE__ << "\n", \
   _assertion_failed(#expr), 0))
 #else
   #define assert(expr)
@@ -118,6 +274,7 @@ struct State {
   static const State Human; // Ally | Enemey
   static const State Wall; // WallAlly | WallEnemy
   static const State Area; // AreaAlly | AreaEnemy
+  static const State Outside; // 盤面外の番兵 (Pond | Castle)
 
   inline constexpr State(const uchar v=0) : val(v){}
   inline constexpr State &operator|=(const State s) noexcept{ val |= s.val; return *this; }
@@ -146,6 +303,12 @@ constexpr State State::Castle = 1 << 7;
 constexpr State State::Human = State::Ally | State::Enemy;
 constexpr State State::Wall = State::WallAlly | State::WallEnemy;
 constexpr State State::Area = State::AreaAlly | State::AreaEnemy;
+constexpr State State::Outside = State::Pond | State::Castle; // 移動, 建築, 破壊のどれもできない
+// Rulesのbitの並び (チーム0 = 敵, チーム1 = 味方) と同じであること
+static_assert(State::WallEnemy == State(Rules::wall(0)) && State::WallAlly == State(Rules::wall(1)));
+static_assert(State::AreaEnemy == State(Rules::area(0)) && State::AreaAlly == State(Rules::area(1)));
+static_assert(State::Enemy == State(Rules::mason(0)) && State::Ally == State(Rules::mason(1)));
+static_assert(State::Pond == State(Rules::Pond) && State::Castle == State(Rules::Castle) && State::Outside == State(Rules::Outside));
 
 
 struct Point {
@@ -206,6 +369,67 @@ inline Point to_point(const int idx) noexcept{
   return Point(idx / width, idx % width);
 }
 
+// 周囲に番兵(State::Outside)を1周付けた1次元の盤面の添字 (Field::cells)
+// 横幅を盤面の大きさによらずpadded_widthに固定しているので、隣のマスへの差分dcellは定数になる
+// 番兵があるので、隣のマスを見るときにis_validの判定はいらない
+constexpr int padded_width = Rules::stride;
+constexpr int padded_size = Rules::padded_size;
+constexpr int dcell[] = {
+  -padded_width, -1, padded_width, 1,
+  -padded_width-1, padded_width-1, padded_width+1, -padded_width+1
+};
+inline constexpr int to_cell(const Point p) noexcept{
+  return Rules::to_index(p.y, p.x);
+}
+inline constexpr Point cell_to_point(const int c) noexcept{
+  return Point(c / padded_width - 1, c % padded_width - 1);
+}
+
+// 盤面の大きさをコンパイル時に決めたもの (H = W = 0 の場合は実行時のheight, width)
+// ループの回数や添字の計算が定数になるように、主要な処理はBoardのテンプレートにしている
+template <int H, int W>
+struct Board {
+  static constexpr bool fixed = H > 0 && W > 0;
+  static inline int h() noexcept{ if constexpr(fixed) return H; else return height; }
+  static inline int w() noexcept{ if constexpr(fixed) return W; else return width; }
+  static inline int size() noexcept{ return h() * w(); }
+  static inline bool is_valid(const Point p) noexcept{
+    return p.y < (Pos)h() && p.x < (Pos)w();
+  }
+  static inline int cell_size() noexcept{ return (h() + 2) * padded_width; } // 番兵を含めて使うcellの数
+  static inline int to_idx(const Point p) noexcept{ return p.y*w() + p.x; }
+  static inline Point to_point(const int idx) noexcept{ return Point(idx / w(), idx % w()); }
+};
+using DynamicBoard = Board<0, 0>;
+
+// 使用するBoardの種類 (set_board_sizeで1度だけ決める)
+// 0: DynamicBoard, 1~: board_sizes[board_kind-1]
+int board_kind = 0;
+constexpr int board_sizes[] = { 11, 13, 15, 17, 21, 25 };
+
+// 盤面の大きさを設定し、対応するBoardを選ぶ
+inline void set_board_size(const int h, const int w) noexcept{
+  height = h; width = w;
+  board_kind = 0;
+  for(int i = 0; i < (int)(sizeof(board_sizes) / sizeof(board_sizes[0])); i++){
+    if(h == board_sizes[i] && w == board_sizes[i]) board_kind = i + 1;
+  }
+}
+
+// 現在の盤面の大きさに対応するBoardを引数にしてfを呼ぶ
+template <class F>
+inline decltype(auto) with_board(F &&f){
+  switch(board_kind){
+    case 1: return f(Board<board_sizes[0], board_sizes[0]>());
+    case 2: return f(Board<board_sizes[1], board_sizes[1]>());
+    case 3: return f(Board<board_sizes[2], board_sizes[2]>());
+    case 4: return f(Board<board_sizes[3], board_sizes[3]>());
+    case 5: return f(Board<board_sizes[4], board_sizes[4]>());
+    case 6: return f(Board<board_sizes[5], board_sizes[5]>());
+    default: return f(DynamicBoard());
+  }
+}
+
 template <class S, class T>
 inline constexpr bool chmin(S &a, const T &b){
   return a > b ? (a = b, 1) : 0;
@@ -226,13 +450,25 @@ constexpr Point dmove[] = {
   Point(-1, 1),
 };
 
+// fromからtoへの方向(dmoveの添字)、隣接していない場合は-1
+inline constexpr int to_dir(const Point from, const Point to) noexcept{
+  for(int dir = 0; dir < 8; dir++){
+    if(from + dmove[dir] == to) return dir;
+  }
+  return -1;
+}
 
+
+//uint randxor32_state = (uint)rand() | (uint)rand() << 16;
+uint randxor32_state = 1210253353;
 inline uint randxor32() noexcept{
-  //static uint y = (uint)rand() | (uint)rand() << 16;
-  static uint y = 1210253353;
+  uint &y = randxor32_state;
   y = y ^ (y << 13); y = y ^ (y >> 17);
   return y = y ^ (y << 5);
 }
+inline void rnd_seed(const uint seed) noexcept{
+  randxor32_state = seed ? seed : 1210253353;
+}
 // returns random [l, r)
 inline int rnd(const int l, const int r) noexcept{
   return randxor32() % (r - l) + l;
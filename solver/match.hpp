@@ -0,0 +1,137 @@
+#pragma once
+
+// 試合サーバーのAPI (GET /matches, GET /matches/{id}, POST /matches/{id}) のJSONとsolverの型の変換
+// 盤面の値はトークンのチームから見たもの (walls, territories: 1:味方 2:敵 (territoriesの3:両方), masons: 正:味方 負:敵)
+#include "json.hpp"
+#include "field.hpp"
+#include "protocol.hpp"
+
+namespace Match {
+
+// Actionのdir(dy,dxの順)とサーバーのdir(1~8, ↖から時計回り)の対応
+constexpr int server_dirs[8] = { 2, 8, 6, 4, 1, 7, 5, 3 };
+
+inline int to_server_dir(const int dir){ return server_dirs[dir]; }
+inline int to_solver_dir(const int server_dir){
+  for(int dir = 0; dir < 8; dir++){
+    if(server_dirs[dir] == server_dir) return dir;
+  }
+  return -1;
+}
+
+// masonsの盤面から職人の位置を番号順に並べる
+inline void read_masons(const Json &masons, const int num, Agents &ally, Agents &enemy){
+  ally.assign(num, Agent());
+  enemy.assign(num, Agent());
+  for(int i = 0; i < masons.size(); i++){
+    for(int j = 0; j < masons[i].size(); j++){
+      const int v = masons[i][j].get_int();
+      if(v == 0 || std::abs(v) > num) continue;
+      (v > 0 ? ally : enemy)[std::abs(v) - 1] = Agent(i, j);
+    }
+  }
+}
+
+// GET /matches の1試合
+struct MatchInfo {
+  int id = 0, turns = 0, turn_seconds = 0;
+  bool first = false;
+  int height = 0, width = 0;
+  std::vector<Point> ponds, castles;
+  Agents ally_agents, enemy_agents;
+
+  // matchesの中からidの試合を探す
+  bool parse(const Json &json, const int match_id){
+    const Json &matches = json["matches"];
+    for(int k = 0; k < matches.size(); k++){
+      const Json &m = matches[k];
+      if(m["id"].get_int(-1) != match_id) continue;
+      const Json &board = m["board"];
+      id = match_id;
+      turns = m["turns"].get_int();
+      turn_seconds = m["turnSeconds"].get_int();
+      first = m["first"].get_bool();
+      height = board["height"].get_int();
+      width = board["width"].get_int();
+      if(height <= 0 || height > max_height || width <= 0 || width > max_width) return false;
+      const Json &structures = board["structures"];
+      ponds.clear();
+      castles.clear();
+      for(int i = 0; i < height; i++){
+        for(int j = 0; j < width; j++){
+          const int v = structures[i][j].get_int();
+          if(v == 1) ponds.emplace_back(i, j);
+          if(v == 2) castles.emplace_back(i, j);
+        }
+      }
+      read_masons(board["masons"], board["mason"].get_int(), ally_agents, enemy_agents);
+      return true;
+    }
+    return false;
+  }
+
+  Field make_field() const{
+    set_board_size(height, width);
+    return Field(height, width, ponds, castles, ally_agents, enemy_agents, first ? 0 : 1, turns, turn_seconds * 1000);
+  }
+};
+
+// GET /matches/{id}
+struct MatchStatus {
+  int turn = -1; // 終わったターン数
+  BoardSnapshot snapshot;
+  const Json *logs = nullptr; // parseに渡したJsonを指す
+
+  bool parse(const Json &json){
+    if(json["turn"].is_null()) return false;
+    turn = json["turn"].get_int();
+    const Json &board = json["board"];
+    const Json &walls = board["walls"], &territories = board["territories"];
+    for(int i = 0; i < height; i++){
+      for(int j = 0; j < width; j++){
+        snapshot.codes[i * max_width + j] = (walls[i][j].get_int() & 3) * 4 + (territories[i][j].get_int() & 3);
+      }
+    }
+    read_masons(board["masons"], board["mason"].get_int(), snapshot.ally_agents, snapshot.enemy_agents);
+    logs = &json["logs"];
+    return true;
+  }
+
+  // turnの行動をm人分読む. 失敗した行動, 記録が無い職人はNone
+  Actions log_actions(const int log_turn, const int m) const{
+    Actions res;
+    for(int i = 0; i < m; i++) res.emplace_back(Action(Action::None, 0, i));
+    if(!logs) return res;
+    for(int k = logs->size() - 1; k >= 0; k--){
+      const Json &log = (*logs)[k];
+      if(log["turn"].get_int() != log_turn) continue;
+      const Json &actions = log["actions"];
+      for(int i = 0; i < std::min(m, actions.size()); i++){
+        const Json &a = actions[i];
+        if(!a["succeeded"].get_bool()) continue;
+        const uchar cmd = Protocol::wire_command[a["type"].get_int() & 3];
+        const int dir = to_solver_dir(a["dir"].get_int());
+        if(cmd == Action::None || dir < 0 || (cmd != Action::Move && dir >= 4)) continue;
+        res[i] = Action(cmd, dir, i);
+      }
+      break;
+    }
+    return res;
+  }
+};
+
+// POST /matches/{id} の本文
+inline std::string action_plan_json(const int turn, const Actions &acts){
+  std::string res = "{\"turn\":" + std::to_string(turn) + ",\"actions\":[";
+  for(int i = 0; i < acts.size(); i++){
+    const Action act = acts[i];
+    const int type = Protocol::wire_command[act.command()];
+    const int dir = act.command() == Action::None ? 0 : to_server_dir(act.dir());
+    if(i) res += ",";
+    res += "{\"type\":" + std::to_string(type) + ",\"dir\":" + std::to_string(dir) + "}";
+  }
+  res += "]}";
+  return res;
+}
+
+} // namespace Match
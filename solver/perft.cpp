@@ -0,0 +1,312 @@
+// perft: 指定した盤面から深さdepthまでの合法な全職人の行動の組を数え上げる
+// enumerate_next_agent_acts(+待機)の直積から Field::is_legal_action で非合法な組を除き、
+// depth >= 2では Field::update_turn で盤面を進める
+// move generatorやupdate_fieldを変更したときに結果が変わらないことの確認と、速度の計測に使う
+// 数える前に、陣地の計算が以前のvisualizerと同じことと、盤面の外への行動が失敗になることも確かめる
+//
+// usage: perft [-D depth] [-v] <map.csv>
+//   -v : 初手の行動の組ごとの数を出力する(divide)
+#define ERRFILE "/dev/null"
+#include <cstdio>
+#include <string>
+#include "base.hpp"
+#include "timer.hpp"
+
+// 各職人の候補手の直積を列挙し、合法な組ごとにfを呼ぶ
+template <class F>
+void for_each_legal_agents_acts(const Field &field, const F &f){
+  const auto &agents = field.get_now_turn_agents();
+  const int agents_num = agents.size();
+  AgentActions cand[max_agent_num];
+  for(int i = 0; i < agents_num; i++){
+    cand[i] = enumerate_next_agent_acts(agents[i], field);
+    cand[i].emplace_back(Action(Action::None));
+    for(auto &act : cand[i]) act.set_agent_idx(i);
+  }
+  int idx[max_agent_num] = {};
+  Actions acts(agents_num, Action());
+  while(true){
+    for(int i = 0; i < agents_num; i++) acts[i] = cand[i][idx[i]];
+    if(field.is_legal_action(acts)) f(acts);
+    int i = 0;
+    while(i < agents_num && ++idx[i] == (int)cand[i].size()) idx[i++] = 0;
+    if(i == agents_num) break;
+  }
+}
+
+ull perft(const Field &field, const int depth){
+  if(depth <= 0 || field.is_finished()) return 1;
+  ull nodes = 0;
+  for_each_legal_agents_acts(field, [&](const Actions &acts){
+    if(depth == 1){
+      nodes++;
+      return;
+    }
+    Field nxt = field;
+    nxt.update_turn(acts);
+    nodes += perft(nxt, depth - 1);
+  });
+  return nodes;
+}
+
+void print_actions(const Field &field, const Actions &acts){
+  static constexpr const char *cmd[] = { "none", "break", "build", "move" };
+  const auto &agents = field.get_now_turn_agents();
+  for(const auto &act : acts){
+    const Point pos = act.target(agents[act.agent_idx()]);
+    std::printf("%s(%d %d) ", cmd[act.command()], (int)pos.y, (int)pos.x);
+  }
+}
+
+// 盤面の隅にいる職人の盤面の外への行動が、盤面を変えずに失敗になるかを調べる
+// (Posは符号なしなので上端, 左端の外は255になる)
+bool check_outside_actions(){
+  const Agents corners = { Point(0, 0), Point(height - 1, width - 1) };
+  bool ok = true;
+  for(const Point agent : corners){
+    const Field base(height, width, {}, {}, { agent }, { Point(height / 2, width / 2) }, 0, 1 << 20, 0);
+    for(const uchar cmd : { Action::Move, Action::Build, Action::Break }){
+      for(int dir = 0; dir < (cmd == Action::Move ? 8 : 4); dir++){
+        const Action act(cmd, dir, 0);
+        if(is_valid(act.target(agent))) continue;
+        Actions acts(1, act);
+        Field nxt = base;
+        nxt.update_turn_and_fix_actions(acts);
+        const bool unchanged = std::equal(base.cells, base.cells + padded_size, nxt.cells) && nxt.ally_agents == base.ally_agents;
+        if(base.is_legal_action(Actions(1, act)) || acts[0].command() != Action::None || !unchanged){
+          std::fprintf(stderr, "outside action is not rejected: cmd %d dir %d from (%d %d)\n", cmd, dir, (int)agent.y, (int)agent.x);
+          ok = false;
+        }
+      }
+    }
+  }
+  return ok;
+}
+
+// 陣地の計算(Rules::update_territory, solverとvisualizerで共有)が、以前のvisualizerの計算と同じかを調べる
+// 以前の計算: 各チームについて外周のマスから自分の城壁を通らずに届かないマスを囲んだマスとし、
+//   両方が囲んだ -> 両方の陣地, 片方だけ -> その片方の陣地, どちらも囲まない -> そのまま, ただし城壁のマスはそのチームの陣地にしない
+//   外周のマスは自分の城壁があっても届いたことにする
+namespace TerritoryCheck {
+
+constexpr State walls[2] = { State::WallAlly, State::WallEnemy };
+constexpr State areas[2] = { State::AreaAlly, State::AreaEnemy };
+
+// 以前のvisualizerの計算をそのまま書いたもの
+std::vector<State> reference(const std::vector<State> &cells, const int h, const int w){
+  std::vector<State> res = cells;
+  std::vector<char> reached[2];
+  for(int t = 0; t < 2; t++){
+    reached[t].assign(h * w, 0);
+    std::vector<int> que;
+    for(int y = 0; y < h; y++){
+      for(int x = 0; x < w; x++){
+        if(y != 0 && y != h - 1 && x != 0 && x != w - 1) continue;
+        reached[t][y * w + x] = 1;
+        if(!(cells[y * w + x] & walls[t])) que.push_back(y * w + x);
+      }
+    }
+    for(size_t i = 0; i < que.size(); i++){
+      const int y = que[i] / w, x = que[i] % w;
+      for(int dir = 0; dir < 4; dir++){
+        const int ny = y + (int)(signed char)dy[dir], nx = x + (int)(signed char)dx[dir];
+        if(ny < 0 || h <= ny || nx < 0 || w <= nx) continue;
+        const int c = ny * w + nx;
+        if(reached[t][c] || (cells[c] & walls[t])) continue;
+        reached[t][c] = 1;
+        que.push_back(c);
+      }
+    }
+  }
+  for(int c = 0; c < h * w; c++){
+    State &st = res[c];
+    const bool in0 = !reached[0][c], in1 = !reached[1][c];
+    if(in0 && in1) st |= State::Area;
+    else if(in0) st = (st | areas[0]) & ~areas[1];
+    else if(in1) st = (st | areas[1]) & ~areas[0];
+    for(int t = 0; t < 2; t++){
+      if(st & walls[t]) st = st & ~areas[t];
+    }
+  }
+  return res;
+}
+
+// 以前のvisualizerの得点 (味方 - 敵)/point_unit
+int reference_score(const std::vector<State> &cells){
+  int points[2] = {};
+  for(const State st : cells){
+    for(int t = 0; t < 2; t++){
+      if(st & walls[t]) points[t] += Rules::wall_point;
+      if(st & areas[t]) points[t] += Rules::area_point + (st & State::Castle ? Rules::castle_point : 0);
+    }
+  }
+  return (points[0] - points[1]) / point_unit;
+}
+
+// Field::update_regionで計算する
+std::vector<State> compute(const std::vector<State> &cells, const int h, const int w, int &score){
+  set_board_size(h, w);
+  Field field(h, w, {}, {}, {}, {}, 0, 1 << 20, 0);
+  for(int c = 0; c < h * w; c++) field.set_state(c / w, c % w, cells[c]);
+  field.update_region();
+  score = field.calc_final_score();
+  std::vector<State> res(h * w);
+  for(int c = 0; c < h * w; c++) res[c] = field.get_state(c / w, c % w);
+  return res;
+}
+
+// 手で作った盤面
+// 入力: '.' なし, 'a' 味方の城壁, 'e' 敵の城壁, 'A' 味方の陣地, 'E' 敵の陣地, 'x' 敵の陣地の上の味方の城壁
+// 期待する陣地: '.' なし, 'a' 味方, 'e' 敵, 'b' 両方
+bool check_case(const char *name, const std::vector<std::string> &board, const std::vector<std::string> &expected){
+  const int h = board.size(), w = board[0].size();
+  std::vector<State> cells(h * w, State::None);
+  for(int c = 0; c < h * w; c++){
+    switch(board[c / w][c % w]){
+      case 'a': cells[c] = State::WallAlly; break;
+      case 'e': cells[c] = State::WallEnemy; break;
+      case 'A': cells[c] = State::AreaAlly; break;
+      case 'E': cells[c] = State::AreaEnemy; break;
+      case 'x': cells[c] = State::WallAlly | State::AreaEnemy; break;
+    }
+  }
+  int score;
+  const std::vector<State> res = compute(cells, h, w, score);
+  bool ok = res == reference(cells, h, w);
+  for(int c = 0; c < h * w; c++){
+    const bool ally = res[c] & State::AreaAlly, enemy = res[c] & State::AreaEnemy;
+    const char got = ally && enemy ? 'b' : ally ? 'a' : enemy ? 'e' : '.';
+    if(got != expected[c / w][c % w]) ok = false;
+  }
+  if(!ok) std::fprintf(stderr, "territory check failed: %s\n", name);
+  return ok;
+}
+
+bool check(){
+  bool ok = true;
+  // 外周の城壁で囲んだ内側は陣地になるが、外周のマスは陣地にならない
+  ok &= check_case("edge walls", {
+    "aaaaa",
+    "a...a",
+    "a...a",
+    "a...a",
+    "aaaaa",
+  }, {
+    ".....",
+    ".aaa.",
+    ".aaa.",
+    ".aaa.",
+    ".....",
+  });
+  // 角のマスは城壁で区切っても囲まれない
+  ok &= check_case("edge corner", {
+    ".a...",
+    "a....",
+    ".....",
+  }, {
+    ".....",
+    ".....",
+    ".....",
+  });
+  // 囲まれていない敵の陣地は残るが、味方の城壁を建てたマスでは消える
+  ok &= check_case("wall on opponent territory", {
+    ".....",
+    ".EEE.",
+    ".ExE.",
+    ".EEE.",
+    ".....",
+  }, {
+    ".....",
+    ".eee.",
+    ".e.e.",
+    ".eee.",
+    ".....",
+  });
+  // 両方が囲んだマスは両方の陣地, 内側の敵の城壁は味方の陣地
+  ok &= check_case("both enclose", {
+    ".......",
+    ".aaaaa.",
+    ".aeeea.",
+    ".ae.ea.",
+    ".aeeea.",
+    ".aaaaa.",
+    ".......",
+  }, {
+    ".......",
+    ".......",
+    "..aaa..",
+    "..aba..",
+    "..aaa..",
+    ".......",
+    ".......",
+  });
+
+  // ランダムな盤面で以前の計算と比べる (Boardの大きさが固定の場合と実行時の場合の両方を通る)
+  rnd_seed(1210253353);
+  for(int iter = 0; iter < 3000 && ok; iter++){
+    int h = rnd(3, max_height + 1), w = rnd(3, max_width + 1);
+    if(iter % 4 == 0) h = w = board_sizes[rnd(std::size(board_sizes))];
+    const int density = rnd(60);
+    std::vector<State> cells(h * w, State::None);
+    for(State &st : cells){
+      const int r = rnd(100);
+      if(r < density) st |= State::WallAlly;
+      else if(r < 2 * density && r < 99) st |= State::WallEnemy;
+      if(!rnd(4)) st |= State::AreaAlly;
+      if(!rnd(4)) st |= State::AreaEnemy;
+      if(!rnd(20)) st |= State::Castle;
+      else if(!rnd(20)) st |= State::Pond;
+    }
+    int score;
+    const std::vector<State> res = compute(cells, h, w, score);
+    const std::vector<State> expected = reference(cells, h, w);
+    if(res != expected || score != reference_score(expected)){
+      std::fprintf(stderr, "territory check failed: random board %d (%dx%d)\n", iter, h, w);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+} // namespace TerritoryCheck
+
+int main(int argc, char *argv[]){
+  int max_depth = 1;
+  bool divide = false;
+  std::string path;
+  for(int i = 1; i < argc; i++){
+    const std::string opt = argv[i];
+    if(opt == "-D" && i + 1 < argc) max_depth = std::stoi(argv[++i]);
+    else if(opt == "-v") divide = true;
+    else path = opt;
+  }
+  if(path.empty()){
+    std::fprintf(stderr, "usage: %s [-D depth] [-v] <map.csv>\n", argv[0]);
+    return 1;
+  }
+  if(!TerritoryCheck::check()) return 1;
+  const Field field = read_field_csv(path, 0, 1 << 20, 0);
+  if(!check_outside_actions()) return 1;
+
+  if(divide){
+    ull total = 0;
+    for_each_legal_agents_acts(field, [&](const Actions &acts){
+      Field nxt = field;
+      nxt.update_turn(acts);
+      const ull nodes = perft(nxt, max_depth - 1);
+      print_actions(field, acts);
+      std::printf(": %llu\n", nodes);
+      total += nodes;
+    });
+    std::printf("total: %llu\n", total);
+    return 0;
+  }
+
+  for(int depth = 1; depth <= max_depth; depth++){
+    StopWatch sw;
+    const ull nodes = perft(field, depth);
+    const double ms = sw.get_ms();
+    std::printf("perft(%d) = %llu, %.1f[ms], %.0f[nodes/s]\n", depth, nodes, ms, nodes / std::max(ms, 1e-3) * 1e3);
+    std::fflush(stdout);
+  }
+}
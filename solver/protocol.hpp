@@ -0,0 +1,303 @@
+#pragma once
+
+// visualizerとの通信
+// 最初の語が"binary"ならバイナリ形式, 数値(盤面の高さ)ならテキスト形式で、以降のやり取りをすべてその形式で行う
+//
+// バイナリ形式は 1フレーム = 種類(1文字) + 固定長の数値列 + '\n' で、フレームごとに1度だけflushする
+// 数値は6bitずつ '0'+v (0x30~0x6F) の1文字にして上位から並べる
+// (Windowsのテキストモードのパイプでも改行の変換やEOF(0x1A)に当たらない文字だけを使う)
+//   I: 初期化   h w side turns(2) TL(3) 池 城 赤の職人 青の職人 (それぞれ 個数(2) + y x の列)
+//   A: 行動     職人数 + 職人ごとに dir*4+type (typeはサーバーと同じ 0:none 1:move 2:build 3:break)
+//   P: 建築予定 個数(2) + y x の列
+//   S: 盤面の同期 前回から変わったマスの個数(2) + y x code の列, 味方の職人, 敵の職人 (職人はIと同じ形式)
+//      codeはBoardSnapshotと同じ. 相手の行動(A)の前に届くことがある
+//   Q: 暫定の行動 Aと同じ形式. 自分のターンには探索中の暫定の行動Qを0個以上送ってから、最終的な行動Aを1つ送る
+//   N: 探索の様子 turn(2) 使った時間(3) 期限(3) SAのステップ数(4) 最大移動コスト(2) score+score_offset(3)
+//      職人数 + 職人ごとの壁の順番, 予定の壁を全て建てたときの陣地 (座標の列はIと同じ形式). Aの後に送る
+// テキスト形式のSは "snapshot" の後に同じ順で数値を並べ、Qは "plan" の後に行動を並べ、Nは "insight" の後に同じ順で数値を並べる
+#include <string>
+#include <cctype>
+#include <limits>
+#include "field.hpp"
+
+namespace Protocol {
+
+enum Mode : uchar { Text, Binary };
+
+constexpr const char *binary_hello = "binary";
+constexpr const char *snapshot_hello = "snapshot";
+constexpr const char *plan_hello = "plan";
+constexpr const char *insight_hello = "insight";
+constexpr int score_offset = 1 << 17; // Nのscoreを負にしないためのずれ
+constexpr const char *command_names[] = { "none", "break", "build", "move" };
+// Action::commandと通信上のtypeの対応 (逆変換も同じ表)
+constexpr uchar wire_command[] = { Action::None, Action::Move, Action::Build, Action::Break };
+
+constexpr int digit_bits = 6;
+constexpr int digit_mask = (1 << digit_bits) - 1;
+constexpr char digit_zero = '0';
+
+// 種類や数値がおかしいフレームはcerrorに出力し、残りを改行まで読み飛ばして失敗にする (以降のdigitsは0を返す)
+// 読む側はoperator boolで確かめる
+struct FrameReader {
+  FrameReader(std::istream &_is, const char _type) : is(_is), type(_type){
+    is >> std::ws;
+    const int c = is.get();
+    if(c != type) fail("invalid frame type", c);
+  }
+  int digits(const int n){
+    int v = 0;
+    for(int i = 0; i < n && ok; i++){
+      const int c = is.get();
+      const int d = c - digit_zero;
+      if(d < 0 || digit_mask < d){
+        fail("invalid digit", c);
+        return 0;
+      }
+      v = v << digit_bits | d;
+    }
+    return ok ? v : 0;
+  }
+  Point point(){
+    const int y = digits(1);
+    const int x = digits(1);
+    return Point(y, x);
+  }
+  std::vector<Point> points(){
+    std::vector<Point> res(digits(2));
+    for(Point &p : res) p = point();
+    return res;
+  }
+  // 数値は読めたが値がおかしい場合に呼ぶ
+  void fail(const char *msg){ fail(msg, 0); }
+  explicit operator bool() const noexcept{ return ok; }
+
+private:
+  void fail(const char *msg, const int c){
+    if(!ok) return;
+    ok = false;
+    cerror << "Error: " << msg << " in frame '" << type << "'";
+    if(std::isprint(c)) cerror << " ('" << (char)c << "')";
+    cerror << "\n";
+    if(c != '\n' && c != std::char_traits<char>::eof()) is.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+
+  std::istream &is;
+  const char type;
+  bool ok = true;
+};
+
+struct FrameWriter {
+  explicit FrameWriter(const char type){ buf.push_back(type); }
+  void digits(const int v, const int n){
+    assert(0 <= v && v >> (digit_bits * n) == 0);
+    for(int i = n - 1; i >= 0; i--) buf.push_back(digit_zero + (v >> (digit_bits * i) & digit_mask));
+  }
+  // n文字に収まらない値は収まる範囲に丸める (表示用の値)
+  void clamped_digits(const int v, const int n){
+    digits(std::clamp(v, 0, (1 << (digit_bits * n)) - 1), n);
+  }
+  template <class Points>
+  void points(const Points &ps){
+    digits(ps.size(), 2);
+    for(const Point p : ps){
+      digits(p.y, 1);
+      digits(p.x, 1);
+    }
+  }
+  void send(std::ostream &os){
+    buf.push_back('\n');
+    os.write(buf.data(), buf.size());
+    os.flush();
+  }
+
+private:
+  std::string buf;
+};
+
+// 自分のターンの探索の様子 (visualizerで表示する)
+struct TurnInsight {
+  int turn = 0;
+  int elapsed_ms = 0, limit_ms = 0; // 使った時間と出力の期限
+  int sa_steps = 0;
+  int best_cost = 0; // 焼きなましで見つけた最良の最大移動コスト
+  int score = 0; // 行動後のcalc_final_score
+  std::vector<Walls> routes; // 職人ごとの建てる予定の壁の順番
+  std::vector<Point> territory; // routesの壁を全て建てたときの味方の陣地
+};
+
+// 最初の入力から通信の形式を決める
+inline Mode negotiate(std::istream &is = std::cin){
+  is >> std::ws;
+  if(!std::isalpha(is.peek())) return Text;
+  std::string hello;
+  is >> hello;
+  assert(hello == binary_hello);
+  return Binary;
+}
+
+inline Field read_field(const Mode mode){
+  if(mode == Text){
+    int h, w;
+    std::cin >> h >> w;
+    return ::read_field(h, w);
+  }
+  FrameReader r(std::cin, 'I');
+  // 盤面がわからなければ対戦できない
+  const auto check = [&r]{
+    if(r) return;
+    cerror << "Error: cannot read the field\n";
+    std::exit(1);
+  };
+  const int h = r.digits(1), w = r.digits(1);
+  const int side = r.digits(1);
+  const int final_turn = r.digits(2);
+  const int TL = r.digits(3);
+  if(side != 0 && side != 1) r.fail("invalid side");
+  if(h < 1 || max_height < h || w < 1 || max_width < w) r.fail("invalid field size");
+  check();
+  set_board_size(h, w);
+  const auto ponds = r.points();
+  const auto castles = r.points();
+  Agents ally_agents, enemy_agents;
+  for(const Point p : r.points()) ally_agents.emplace_back(p);
+  for(const Point p : r.points()) enemy_agents.emplace_back(p);
+  check();
+  return Field(h, w, ponds, castles, ally_agents, enemy_agents, side, final_turn, TL);
+}
+
+// m人分の行動を読む
+inline Actions read_actions(const Mode mode, const int m){
+  Actions res;
+  if(mode == Text){
+    for(int i = 0; i < m; i++){
+      int dir; std::string str;
+      std::cin >> dir >> str;
+      uchar cmd = Action::None;
+      if(str == "move") cmd = Action::Move;
+      if(str == "build") cmd = Action::Build;
+      if(str == "break") cmd = Action::Break;
+      if(cmd == Action::None) dir = 0;
+      res.emplace_back(Action(cmd, dir, i));
+    }
+    return res;
+  }
+  FrameReader r(std::cin, 'A');
+  const int n = r.digits(1);
+  if(r && n != m) r.fail("invalid number of agents");
+  for(int i = 0; i < n && r; i++){
+    const int v = r.digits(1);
+    const uchar cmd = wire_command[v & 3];
+    res.emplace_back(Action(cmd, cmd == Action::None ? 0 : v >> 2, i));
+  }
+  // 読めなければvisualizerと同じく全員何もしない行動として扱う
+  if(!r){
+    res.clear();
+    for(int i = 0; i < m; i++) res.emplace_back(Action(Action::None, 0, i));
+  }
+  return res;
+}
+
+inline Walls read_build_plan(const Mode mode){
+  Walls res;
+  if(mode == Text){
+    int walls_num;
+    std::cin >> walls_num;
+    for(int i = 0; i < walls_num; i++){
+      Point p;
+      std::cin >> p;
+      res.push_back(p);
+    }
+    return res;
+  }
+  FrameReader r(std::cin, 'P');
+  for(const Point p : r.points()) res.push_back(p);
+  if(!r) res.clear();
+  return res;
+}
+
+// 次が盤面の同期なら読んでsnapに反映し、trueを返す
+inline bool read_snapshot(const Mode mode, BoardSnapshot &snap){
+  std::cin >> std::ws;
+  if(mode == Text){
+    if(!std::isalpha(std::cin.peek())) return false;
+    std::string hello;
+    std::cin >> hello;
+    assert(hello == snapshot_hello);
+    auto get_agents = [](Agents &agents){
+      int num;
+      std::cin >> num;
+      agents.resize(num);
+      for(Agent &a : agents) std::cin >> a;
+    };
+    int num;
+    std::cin >> num;
+    for(int i = 0; i < num; i++){
+      Point p; int code;
+      std::cin >> p >> code;
+      snap.codes[p.y * max_width + p.x] = code;
+    }
+    get_agents(snap.ally_agents);
+    get_agents(snap.enemy_agents);
+    return true;
+  }
+  if(std::cin.peek() != 'S') return false;
+  FrameReader r(std::cin, 'S');
+  const int num = r.digits(2);
+  for(int i = 0; i < num; i++){
+    const Point p = r.point();
+    snap.codes[p.y * max_width + p.x] = r.digits(1);
+  }
+  snap.ally_agents.clear();
+  snap.enemy_agents.clear();
+  for(const Point p : r.points()) snap.ally_agents.emplace_back(p);
+  for(const Point p : r.points()) snap.enemy_agents.emplace_back(p);
+  return (bool)r;
+}
+
+// provisionalなら探索途中の暫定の行動として送る
+inline void write_actions(const Mode mode, const Actions &acts, const bool provisional = false){
+  if(mode == Text){
+    if(provisional) std::cout << plan_hello << "\n";
+    for(const auto &act : acts){
+      std::cout << act.dir() << " " << command_names[act.command()] << "\n";
+    }
+    std::cout << std::flush;
+    return;
+  }
+  FrameWriter w(provisional ? 'Q' : 'A');
+  w.digits(acts.size(), 1);
+  for(const auto &act : acts) w.digits(act.dir() << 2 | wire_command[act.command()], 1);
+  w.send(std::cout);
+}
+
+inline void write_insight(const Mode mode, const TurnInsight &insight){
+  if(mode == Text){
+    const auto put_points = [](const auto &ps){
+      std::cout << ps.size();
+      for(const Point p : ps) std::cout << " " << p;
+      std::cout << "\n";
+    };
+    std::cout << insight_hello << "\n"
+              << insight.turn << " " << insight.elapsed_ms << " " << insight.limit_ms << " "
+              << insight.sa_steps << " " << insight.best_cost << " " << insight.score << "\n"
+              << insight.routes.size() << "\n";
+    for(const Walls &route : insight.routes) put_points(route);
+    put_points(insight.territory);
+    std::cout << std::flush;
+    return;
+  }
+  FrameWriter w('N');
+  w.clamped_digits(insight.turn, 2);
+  w.clamped_digits(insight.elapsed_ms, 3);
+  w.clamped_digits(insight.limit_ms, 3);
+  w.clamped_digits(insight.sa_steps, 4);
+  w.clamped_digits(insight.best_cost, 2);
+  w.clamped_digits(insight.score + score_offset, 3);
+  w.digits(insight.routes.size(), 1);
+  for(const Walls &route : insight.routes) w.points(route);
+  w.points(insight.territory);
+  w.send(std::cout);
+}
+
+} // namespace Protocol
@@ -0,0 +1,113 @@
+// 記録した試合の状況を順に返す、ローカルの試合サーバーの代わり (clientの動作確認用)
+// 最初の /matches/{id} へのリクエスト(GETでもPOSTでも)からturn_msごとに次のstatusファイルに進み、最後のファイルで止まる
+//
+// usage: replay_server [-p port] [-i turn_ms] <matches.json> <status.json...>
+//   GET  /matches      : matches.json
+//   GET  /matches/{id} : 現在のstatusファイル
+//   POST /matches/{id} : 受け取った行動計画をstderrに出して {"accepted_at":...} を返す
+//   client -r で保存したディレクトリなら replay_server dir/matches.json dir/status_*.json で再生できる
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <thread>
+#include "http.hpp"
+#include "timer.hpp"
+
+std::string read_file(const char *path){
+  std::ifstream is(path);
+  if(!is){
+    std::fprintf(stderr, "cannot open %s\n", path);
+    std::exit(1);
+  }
+  std::stringstream ss;
+  ss << is.rdbuf();
+  return ss.str();
+}
+
+bool respond(const Net::socket_t s, const int status, const std::string &body){
+  const std::string head = "HTTP/1.1 " + std::to_string(status) + (status == 200 ? " OK" : " Not Found") + "\r\n"
+                           "Content-Type: application/json\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: keep-alive\r\n\r\n";
+  return Net::send_all(s, head + body);
+}
+
+int main(int argc, char *argv[]){
+  int port = 3000, turn_ms = 1000;
+  std::vector<const char*> files;
+  for(int i = 1; i < argc; i++){
+    const std::string opt = argv[i];
+    if(opt == "-p" && i + 1 < argc) port = std::stoi(argv[++i]);
+    else if(opt == "-i" && i + 1 < argc) turn_ms = std::max(1, std::stoi(argv[++i]));
+    else files.push_back(argv[i]);
+  }
+  if(files.size() < 2){
+    std::fprintf(stderr, "usage: %s [-p port] [-i turn_ms] <matches.json> <status.json...>\n", argv[0]);
+    return 1;
+  }
+  const std::string matches = read_file(files[0]);
+  std::vector<std::string> statuses;
+  for(size_t i = 1; i < files.size(); i++) statuses.emplace_back(read_file(files[i]));
+
+  const Net::socket_t listener = Net::listen_tcp(port);
+  if(listener == Net::invalid_socket){
+    std::fprintf(stderr, "cannot listen on port %d\n", port);
+    return 1;
+  }
+  std::fprintf(stderr, "listening on 127.0.0.1:%d, %d statuses, %d[ms]/turn\n", port, (int)statuses.size(), turn_ms);
+
+  std::mutex mtx; // started, startとstderrへの出力を守る
+  bool started = false;
+  steady_clock::time_point start;
+  // 試合開始からの経過時間. 最初の /matches/{id} へのリクエストで開始する (mtxを取ってから呼ぶ)
+  const auto match_elapsed_ms = [&]{
+    if(!started){
+      started = true;
+      start = steady_clock::now();
+    }
+    return elapsed_ms(start);
+  };
+  // 接続ごとにスレッドを立てる (clientは最終的な行動と暫定の行動で2本の接続を使う)
+  const auto serve = [&](const Net::socket_t s){
+    HttpStream stream;
+    stream.reset(s);
+    std::string request_line, body;
+    while(stream.read_head(request_line) && stream.read_body(body, false)){
+      std::istringstream ss(request_line);
+      std::string method, target;
+      ss >> method >> target;
+      const std::string path = target.substr(0, target.find('?'));
+      bool ok;
+      if(method == "GET" && path == "/matches"){
+        ok = respond(s, 200, matches);
+      }else if(method == "GET" && path.rfind("/matches/", 0) == 0){
+        size_t idx;
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          idx = std::min(statuses.size() - 1, (size_t)(match_elapsed_ms() / turn_ms));
+        }
+        ok = respond(s, 200, statuses[idx]);
+      }else if(method == "POST" && path.rfind("/matches/", 0) == 0){
+        long long accepted_at;
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          std::fprintf(stderr, "POST %s %s\n", path.c_str(), body.c_str());
+          accepted_at = match_elapsed_ms();
+        }
+        ok = respond(s, 200, "{\"accepted_at\":" + std::to_string(accepted_at) + "}");
+      }else{
+        ok = respond(s, 404, "{}");
+      }
+      if(!ok) break;
+    }
+    Net::close_socket(s);
+  };
+  while(true){
+    const Net::socket_t s = accept(listener, nullptr, nullptr);
+    if(s == Net::invalid_socket) continue;
+    std::thread(serve, s).detach();
+  }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+// 試合のルールの中核 (solverとvisualizerの両方から使う)
+// 標準ライブラリ以外に依存せず、グローバルな状態も持たない
+//
+// 盤面は周囲に番兵(Outside)を1周付けた1次元の配列で、横幅は盤面の大きさによらずstrideに固定する
+// マスの型Tは8bitの状態(solverのState, visualizerのCELL)で、uint8_tから作れて &, |, ~, bool変換を持つもの
+// bitの並びは両方で同じで、チーム0, 1の城壁, 陣地, 職人を持つ
+//   solver    : チーム0 = 敵, チーム1 = 味方
+//   visualizer: チーム0 = 赤, チーム1 = 青
+// Dimsは盤面の大きさ h(), w() を持つ型 (solverのBoard<H,W>ならループの回数がコンパイル時に決まる)
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+namespace Rules {
+
+// 得点 (公式のルール)
+constexpr int castle_point = 100, area_point = 30, wall_point = 10;
+
+constexpr int max_height = 25, max_width = 25;
+constexpr int stride = max_width + 2;
+constexpr int padded_size = (max_height + 2) * stride;
+constexpr int dindex[4] = { -stride, -1, stride, 1 };
+inline constexpr int to_index(const int y, const int x) noexcept{ return (y + 1) * stride + (x + 1); }
+
+// マスの状態
+constexpr uint8_t Pond = 1 << 0;
+constexpr uint8_t Castle = 1 << 7;
+inline constexpr uint8_t wall(const int team) noexcept{ return 2 << team; }
+inline constexpr uint8_t area(const int team) noexcept{ return 8 << team; }
+inline constexpr uint8_t mason(const int team) noexcept{ return 32 << team; }
+constexpr uint8_t Walls = wall(0) | wall(1);
+constexpr uint8_t Areas = area(0) | area(1);
+constexpr uint8_t Masons = mason(0) | mason(1);
+constexpr uint8_t Outside = Pond | Castle; // 番兵 (移動, 建築, 破壊のどれもできない)
+
+// 行動できないマス (同じターンの行動どうしの衝突は呼ぶ側で調べる)
+// 破壊: 城壁がないマス
+constexpr uint8_t break_target = Walls;
+// 建築: 相手の城壁, 相手の職人, 城があるマス (自分の城壁があるマスは建築しても変わらない)
+inline constexpr uint8_t build_blocker(const int team) noexcept{ return wall(team ^ 1) | mason(team ^ 1) | Castle; }
+// 移動: 職人, 池, 相手の城壁があるマス
+inline constexpr uint8_t move_blocker(const int team) noexcept{ return Masons | Pond | wall(team ^ 1); }
+
+// 番兵を書き込み、盤面の中を空にする
+template <class T, class Dims>
+void clear(T *cells, const Dims &dims){
+  std::fill(cells, cells + padded_size, T(Outside));
+  for(int i = 0; i < dims.h(); i++) std::fill(cells + to_index(i, 0), cells + to_index(i, dims.w()), T(0));
+}
+
+// 陣地の更新
+// 自分の城壁を通らずに盤面の外周から届かないマス(囲みに使った自分の城壁のマスも含む)を、そのチームが囲んだマスとする
+//   両方が囲んだマス   -> 両方の陣地
+//   片方だけが囲んだマス -> その片方の陣地 (もう片方の陣地は外れる)
+//   どちらも囲まないマス -> そのまま
+// ただし城壁のマスはそのチームの陣地にならない
+template <class T, class Dims>
+void update_territory(T *cells, const Dims &dims){
+  const int h = dims.h(), w = dims.w();
+  uint8_t reached[2][padded_size]; // 外周から届いたか (番兵は届いたことにして塗らない)
+  int que[max_height * max_width];
+
+  for(int t = 0; t < 2; t++){
+    const T my_wall(wall(t));
+    uint8_t *seen = reached[t];
+    std::fill(seen, seen + (h + 2) * stride, 1);
+    for(int i = 0; i < h; i++) std::fill(seen + to_index(i, 0), seen + to_index(i, w), 0);
+    int head = 0, tail = 0;
+    const auto push = [&](const int c){
+      if(!seen[c] && !(cells[c] & my_wall)){
+        seen[c] = 1;
+        que[tail++] = c;
+      }
+    };
+    // 外周のマスは城壁があっても囲まれない
+    const auto push_edge = [&](const int c){
+      if(seen[c]) return;
+      seen[c] = 1;
+      if(!(cells[c] & my_wall)) que[tail++] = c;
+    };
+    for(int i = 0; i < h; i++){
+      push_edge(to_index(i, 0));
+      push_edge(to_index(i, w - 1));
+    }
+    for(int j = 0; j < w; j++){
+      push_edge(to_index(0, j));
+      push_edge(to_index(h - 1, j));
+    }
+    while(head < tail){
+      const int c = que[head++];
+      for(int dir = 0; dir < 4; dir++) push(c + dindex[dir]);
+    }
+  }
+
+  for(int i = 0; i < h; i++){
+    const int row = to_index(i, 0);
+    for(int c = row; c < row + w; c++){
+      T st = cells[c];
+      const bool in0 = !reached[0][c], in1 = !reached[1][c];
+      if(in0 && in1) st = st | T(Areas);
+      else if(in0) st = (st | T(area(0))) & ~T(area(1));
+      else if(in1) st = (st | T(area(1))) & ~T(area(0));
+      if(st & T(wall(0))) st = st & ~T(area(0));
+      if(st & T(wall(1))) st = st & ~T(area(1));
+      cells[c] = st;
+    }
+  }
+}
+
+// 1チーム分の城壁, 陣地, 陣地の中の城の数
+struct Count {
+  int walls = 0, areas = 0, castles = 0;
+  constexpr int points() const noexcept{ return walls * wall_point + areas * area_point + castles * castle_point; }
+};
+
+// チーム0, 1の数を数える
+template <class T, class Dims>
+std::array<Count, 2> count(const T *cells, const Dims &dims){
+  int walls0 = 0, walls1 = 0, areas0 = 0, areas1 = 0, castles0 = 0, castles1 = 0;
+  for(int i = 0; i < dims.h(); i++){
+    const T *row = cells + to_index(i, 0);
+    for(int j = 0; j < dims.w(); j++){
+      const T st = row[j];
+      if(st & T(wall(0))) walls0++;
+      if(st & T(wall(1))) walls1++;
+      if(st & T(area(0))) areas0++;
+      if(st & T(area(1))) areas1++;
+      if(st & T(Castle)){
+        if(st & T(area(0))) castles0++;
+        if(st & T(area(1))) castles1++;
+      }
+    }
+  }
+  std::array<Count, 2> res;
+  res[0] = { walls0, areas0, castles0 };
+  res[1] = { walls1, areas1, castles1 };
+  return res;
+}
+
+} // namespace Rules
@@ -0,0 +1,88 @@
+#pragma once
+
+// solverを別プロセスではなくライブラリとして呼ぶためのAPI
+// 実装はsolver_lib.cppにあり、呼ぶ側のプログラムと一緒にビルドする (solverの他のヘッダは見せない)
+// 盤面の大きさなどをグローバルに持つので、同時に使えるSolverは1つだけ
+// visualizerに組み込むにはMSVCでビルドする必要があるが、まだ確かめていない (GCCで_MSC_VERの分岐をコンパイルしただけ)
+//
+// 使い方 (computer.cppの標準入出力のやり取りと同じ順):
+//   solver.init(map);
+//   自分のターンなら solver.think(deadline, on_plan);
+//   相手のターンが終わったら [solver.sync(board);] solver.set_build_plan(walls); solver.on_enemy_actions(acts);
+// 座標は {y, x}, 行動の種類は通信と同じ 0:none 1:move 2:build 3:break, 向きはsolverの向き(0~7)
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <functional>
+
+namespace SolverAPI {
+
+using Coord = std::pair<int, int>;
+using Coords = std::vector<Coord>;
+
+struct MapInfo {
+  int height = 0, width = 0;
+  bool first = true; // 先手か
+  int turns = 0; // 試合のターン数
+  int turn_ms = 0; // 1ターンの持ち時間
+  Coords ponds, castles;
+  Coords ally, enemy; // 職人の位置 (職人の番号順)
+};
+
+struct Act {
+  int dir = 0;
+  int type = 0;
+};
+using Acts = std::vector<Act>;
+
+// サーバーの盤面 (codes[y*width+x] = 城壁(0:なし 1:味方 2:敵)*4 + 陣地(bit0:味方 bit1:敵))
+struct Board {
+  std::vector<int> codes;
+  Coords ally, enemy;
+};
+
+// 暫定の行動(is_final = false)と最終的な行動(is_final = true)を受け取る
+// 探索のスレッド, 期限を見張るスレッド, 暫定の行動を送るスレッドのどれかから呼ばれるが、同時に呼ばれることはない
+using PlanCallback = std::function<void(const Acts &acts, bool is_final)>;
+
+// 自分のターンの探索の様子 (protocol.hppのNと同じ内容)
+struct Insight {
+  int turn = 0;
+  int elapsed_ms = 0, limit_ms = 0; // 使った時間と出力の期限
+  int sa_steps = 0;
+  int best_cost = 0; // 焼きなましで見つけた最良の最大移動コスト
+  int score = 0; // 行動後の評価 (味方 - 敵)
+  std::vector<Coords> routes; // 職人ごとの建てる予定の壁の順番
+  Coords territory; // routesの壁を全て建てたときの味方の陣地
+};
+// 最終的な行動を渡した後に呼ばれる
+using InsightCallback = std::function<void(const Insight &insight)>;
+
+class Solver {
+public:
+  Solver();
+  ~Solver();
+  Solver(const Solver&) = delete;
+  Solver &operator=(const Solver&) = delete;
+
+  void init(const MapInfo &map);
+  // 次のon_enemy_actionsで使う建築予定
+  void set_build_plan(const Coords &walls);
+  // 次のon_enemy_actionsの後で盤面をboardに合わせる
+  void sync(const Board &board);
+  // 相手のターンの行動を反映する (ここから自分のターンの時間を測る)
+  void on_enemy_actions(const Acts &acts);
+  // deadlineまでに最終的な行動を決めて返す (on_planにも渡し、その後で探索の様子をon_insightに渡す)
+  Acts think(std::chrono::steady_clock::time_point deadline, const PlanCallback &on_plan = nullptr,
+             const InsightCallback &on_insight = nullptr);
+
+  bool is_my_turn() const;
+  bool is_finished() const;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
+
+} // namespace SolverAPI
@@ -0,0 +1,135 @@
+// solver_api.hppの実装
+// solverのヘッダはグローバルな定義を含むので、この翻訳単位の中だけでincludeする
+#include "solver_api.hpp"
+#include "game.hpp"
+
+namespace SolverAPI {
+
+namespace {
+
+std::vector<Point> to_points(const Coords &coords){
+  std::vector<Point> res;
+  for(const auto &[y, x] : coords) res.emplace_back(y, x);
+  return res;
+}
+
+Agents to_agents(const Coords &coords){
+  Agents res;
+  for(const auto &[y, x] : coords) res.emplace_back(y, x);
+  return res;
+}
+
+Actions to_actions(const Acts &acts){
+  Actions res;
+  for(int i = 0; i < (int)acts.size(); i++){
+    const uchar cmd = Protocol::wire_command[acts[i].type & 3];
+    res.emplace_back(Action(cmd, cmd == Action::None ? 0 : acts[i].dir, i));
+  }
+  return res;
+}
+
+template <class Points>
+Coords to_coords(const Points &points){
+  Coords res;
+  for(const Point p : points) res.emplace_back(p.y, p.x);
+  return res;
+}
+
+Acts to_acts(const Actions &acts){
+  Acts res;
+  for(const auto &act : acts) res.push_back({ act.dir(), Protocol::wire_command[act.command()] });
+  return res;
+}
+
+} // namespace
+
+struct Solver::Impl {
+  std::unique_ptr<Game> game;
+  bool resync = false; // 次の相手のターンの後でsnapshotに合わせるか
+  PlanCallback on_plan; // thinkの間だけ設定する
+  InsightCallback on_insight; // thinkの間だけ設定する
+  Actions final_acts;
+  // 暫定の行動はGameの送信用のスレッドから届くので、on_planを直列にし、最終的な行動より後には渡さない
+  std::mutex output_mtx;
+  bool final_done = false;
+
+  void output(const Actions &acts, const bool is_final){
+    std::lock_guard<std::mutex> lock(output_mtx);
+    if(final_done) return;
+    if(is_final){
+      final_acts = acts;
+      final_done = true;
+    }
+    if(on_plan) on_plan(to_acts(acts), is_final);
+  }
+
+  void output_insight(const Protocol::TurnInsight &in){
+    if(!on_insight) return;
+    Insight res;
+    res.turn = in.turn;
+    res.elapsed_ms = in.elapsed_ms;
+    res.limit_ms = in.limit_ms;
+    res.sa_steps = in.sa_steps;
+    res.best_cost = in.best_cost;
+    res.score = in.score;
+    for(const Walls &route : in.routes) res.routes.push_back(to_coords(route));
+    res.territory = to_coords(in.territory);
+    on_insight(res);
+  }
+};
+
+Solver::Solver() : impl(new Impl){}
+Solver::~Solver() = default;
+
+void Solver::init(const MapInfo &map){
+  set_board_size(map.height, map.width);
+  const Field field(map.height, map.width, to_points(map.ponds), to_points(map.castles),
+                    to_agents(map.ally), to_agents(map.enemy), map.first ? 0 : 1, map.turns, map.turn_ms);
+  Impl *p = impl.get();
+  impl->game.reset(new Game(field, [p](const Actions &acts){ p->output(acts, true); }));
+  impl->game->progress = [p](const Actions &acts){ p->output(acts, false); };
+  impl->game->insight = [p](const Protocol::TurnInsight &insight){ p->output_insight(insight); };
+  impl->resync = false;
+  impl->game->field.debug();
+}
+
+void Solver::set_build_plan(const Coords &walls){
+  Walls &build_walls = impl->game->build_walls;
+  build_walls.clear();
+  for(const auto &[y, x] : walls) build_walls.emplace_back(y, x);
+}
+
+void Solver::sync(const Board &board){
+  BoardSnapshot &snap = impl->game->snapshot;
+  for(int y = 0; y < height; y++){
+    for(int x = 0; x < width; x++) snap.codes[y * max_width + x] = board.codes[y * width + x];
+  }
+  snap.ally_agents = to_agents(board.ally);
+  snap.enemy_agents = to_agents(board.enemy);
+  impl->resync = true;
+}
+
+void Solver::on_enemy_actions(const Acts &acts){
+  Game &game = *impl->game;
+  game.time_manager.start_turn();
+  game.update_enemy_turn(to_actions(acts), impl->resync);
+  impl->resync = false;
+}
+
+Acts Solver::think(const std::chrono::steady_clock::time_point deadline, const PlanCallback &on_plan,
+                   const InsightCallback &on_insight){
+  Game &game = *impl->game;
+  impl->on_plan = on_plan;
+  impl->on_insight = on_insight;
+  impl->final_done = false;
+  game.run(game.time_manager.deadline_until(deadline));
+  impl->on_plan = nullptr;
+  impl->on_insight = nullptr;
+  cerr << "Elapsed Time: " << game.time_manager.turn_elapsed_ms() << "[ms]\n";
+  return to_acts(impl->final_acts);
+}
+
+bool Solver::is_my_turn() const{ return impl->game->field.is_my_turn(); }
+bool Solver::is_finished() const{ return impl->game->field.is_finished(); }
+
+} // namespace SolverAPI
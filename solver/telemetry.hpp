@@ -0,0 +1,52 @@
+#pragma once
+
+// 自分のターンごとの計測値をJSON lines(1行1ターン)で出力する
+// 出力先はTELEMETRYFILE (default: telemetry.jsonl), NOTELEMETRYを定義すると出力しない
+#include <cstdio>
+#include "base.hpp"
+
+#ifndef TELEMETRYFILE
+  #define TELEMETRYFILE "telemetry.jsonl"
+#endif
+
+struct TurnRecord {
+  int turn = 0;
+  double elapsed_ms = 0; // 入力が届いてから出力を終えるまで
+  double soft_ms = 0, hard_ms = 0; // 探索の期限 (ターン開始から)
+  bool timeout = false; // Watchdogが出力したか
+  int plans = 0; // 最終的な行動より前に出力した暫定の行動の数
+  SearchStats search;
+  int score = 0; // 行動後のcalc_final_score
+  double eval = 0; // 行動後のEvaluate::evaluate_field
+};
+
+struct Telemetry {
+#ifndef NOTELEMETRY
+  Telemetry() : fp(std::fopen(TELEMETRYFILE, "w")){}
+#else
+  Telemetry() : fp(nullptr){}
+#endif
+  ~Telemetry(){ if(fp) std::fclose(fp); }
+  Telemetry(const Telemetry&) = delete;
+  Telemetry &operator=(const Telemetry&) = delete;
+
+  void write(const TurnRecord &r){
+    if(!fp) return;
+    const SearchStats &s = r.search;
+    std::fprintf(fp,
+      "{\"turn\":%d,\"elapsed_ms\":%.3f,\"soft_ms\":%.3f,\"hard_ms\":%.3f,\"slack_ms\":%.3f,\"timeout\":%s,\"plans\":%d,"
+      "\"phase_ms\":{\"partition\":%.3f,\"tsp\":%.3f,\"sa\":%.3f,\"extract\":%.3f,\"cost_table\":%.3f},"
+      "\"sa\":{\"steps\":%d,\"accepted\":%d,\"improved\":%d,\"accept_rate\":%.4f,\"first_cost\":%d,\"final_cost\":%d},"
+      "\"evals\":%lld,\"cost_table\":{\"lookups\":%lld,\"misses\":%lld,\"hit_rate\":%.4f},"
+      "\"score\":%d,\"eval\":%.4f}\n",
+      r.turn, r.elapsed_ms, r.soft_ms, r.hard_ms, r.hard_ms - r.elapsed_ms, r.timeout ? "true" : "false", r.plans,
+      s.partition_ms, s.tsp_ms, s.sa_ms, s.extract_ms, s.cost_table_ms,
+      s.sa_steps, s.sa_accepted, s.sa_improved, s.sa_steps ? (double)s.sa_accepted / s.sa_steps : 0.0, s.first_cost, s.final_cost,
+      s.evals, s.cost_lookups, s.cost_misses, s.cost_lookups ? 1.0 - (double)s.cost_misses / s.cost_lookups : 0.0,
+      r.score, r.eval);
+    std::fflush(fp);
+  }
+
+private:
+  std::FILE *fp;
+};
@@ -1,11 +1,120 @@
 #pragma once
 
 #include <chrono>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <algorithm>
+
+// 時間はすべて単調増加するsteady_clockで測る
+using steady_clock = std::chrono::steady_clock;
+
+inline double elapsed_ms(const steady_clock::time_point from, const steady_clock::time_point to = steady_clock::now()){
+  return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count() * 1e-3;
+}
+inline steady_clock::time_point after_ms(const steady_clock::time_point from, const double ms){
+  return from + std::chrono::microseconds((long long)(ms * 1e3));
+}
 
 struct StopWatch {
-  const std::chrono::system_clock::time_point start_time;
-  StopWatch() : start_time(std::chrono::system_clock::now()){}
-  inline double get_ms() const noexcept{
-    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_time).count() * 1e-3;
+  steady_clock::time_point start_time;
+  StopWatch() : start_time(steady_clock::now()){}
+  inline void reset() noexcept{ start_time = steady_clock::now(); }
+  inline double get_ms() const noexcept{ return elapsed_ms(start_time); }
+  // 前回のlap(またはreset)からの時間を返して計測し直す
+  inline double lap_ms() noexcept{
+    const auto now = steady_clock::now();
+    const double ms = elapsed_ms(start_time, now);
+    start_time = now;
+    return ms;
+  }
+};
+
+// 探索の打ち切り時刻
+// soft: 探索を終えて結果をまとめ始める時刻, hard: 出力が間に合わなくなる時刻
+struct Deadline {
+  steady_clock::time_point start, soft, hard;
+  Deadline(const double soft_ms, const double hard_ms, const steady_clock::time_point _start = steady_clock::now())
+    : start(_start), soft(after_ms(_start, soft_ms)), hard(after_ms(_start, std::max(soft_ms, hard_ms))){}
+  static Deadline unlimited(){ return Deadline(1e12, 1e12); }
+
+  inline bool expired() const noexcept{ return steady_clock::now() >= soft; }
+  inline double remaining_ms() const noexcept{ return elapsed_ms(steady_clock::now(), soft); }
+  // 開始からsoftまでのうち経過した割合 (焼きなましの温度などに使う)
+  inline double progress() const noexcept{
+    const double total = elapsed_ms(start, soft);
+    return total <= 0 ? 1.0 : elapsed_ms(start) / total;
+  }
+};
+
+// 1ターンの思考時間の管理
+// visualizerは持ち時間TLのread_ratioの時点で出力を読むので、それまでに出力を終える
+// 探索後の処理(経路の復元, 出力)にかかった時間を計測し、次のターンからその分を早めに探索を打ち切る
+struct TimeManager {
+  static constexpr double read_ratio = 0.9;
+  static constexpr double safety_ms = 5;
+
+  explicit TimeManager(const int _TL) : TL(_TL), finish_ms(_TL * 0.1){}
+
+  // 自分のターンの入力が届いた時点で呼ぶ
+  void start_turn(){
+    turn_start = steady_clock::now();
+    search_end = turn_start;
+  }
+  // 探索の期限 (start_turnからの時間)
+  Deadline deadline() const{ return deadline_until(after_ms(turn_start, TL * read_ratio)); }
+  // limitまでに出力を終えるときの探索の期限
+  Deadline deadline_until(const steady_clock::time_point limit) const{
+    const double hard_ms = std::max(0.0, elapsed_ms(turn_start, limit) - safety_ms);
+    const double soft_ms = std::max(0.0, hard_ms - 2 * finish_ms);
+    return Deadline(soft_ms, hard_ms, turn_start);
+  }
+  // 探索を終えた時点で呼ぶ
+  void end_search(){ search_end = steady_clock::now(); }
+  // 出力を終えた時点で呼ぶ
+  void end_turn(){
+    const double ms = elapsed_ms(search_end);
+    finish_ms = finish_ms * 0.7 + ms * 0.3;
+  }
+  double turn_elapsed_ms() const{ return elapsed_ms(turn_start); }
+
+  const int TL; // 1ターンの持ち時間[ms]
+
+private:
+  double finish_ms; // 探索後の処理にかかる時間[ms]の推定値
+  steady_clock::time_point turn_start = steady_clock::now(), search_end = steady_clock::now();
+};
+
+// 期限までに出力が終わらなかった場合に、別スレッドでon_timeoutを呼ぶ
+// 出力は claim() に成功した側(メインスレッドかWatchdog)だけが行う
+struct Watchdog {
+  Watchdog(const steady_clock::time_point limit, std::function<void()> on_timeout)
+    : thread([this, limit, f = std::move(on_timeout)]{
+        std::unique_lock<std::mutex> lock(mtx);
+        if(cv.wait_until(lock, limit, [&]{ return cancelled; })) return;
+        lock.unlock();
+        if(claim()) f();
+      }){}
+  ~Watchdog(){
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      cancelled = true;
+    }
+    cv.notify_one();
+    thread.join();
   }
+  Watchdog(const Watchdog&) = delete;
+  Watchdog &operator=(const Watchdog&) = delete;
+
+  // 出力する権利を得る (最初の1回だけtrue)
+  bool claim(){ return !claimed.exchange(true); }
+
+private:
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool cancelled = false;
+  std::atomic<bool> claimed{false};
+  std::thread thread;
 };
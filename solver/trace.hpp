@@ -0,0 +1,106 @@
+#pragma once
+
+// 処理の区間をChrome trace形式(chrome://tracing, ui.perfetto.dev で開ける)で記録する
+// ENABLE_TRACEを定義したときだけ有効で、それ以外ではTRACE_SCOPEは何もしない
+//   TRACE_SCOPE("name"); : そのスコープを抜けるまでを1区間として記録する
+//   TRACE_SCOPE_VAR(var, "name"); ... TRACE_CLOSE(var); : スコープの途中で区間を終える
+//   dump_trace();        : 全スレッドの記録をTRACEFILE(default: trace.json)に書き出す
+// TRACK_ALLOCを定義した場合は、同じ区間ごとにヒープ確保も集計する (alloc_tracker.hpp)
+#include "alloc_tracker.hpp"
+
+#ifdef ENABLE_TRACE
+#include <cstdio>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include "timer.hpp"
+
+#ifndef TRACEFILE
+  #define TRACEFILE "trace.json"
+#endif
+
+struct TraceEvent {
+  const char *name; // 文字列リテラルのみ
+  long long begin_us, dur_us;
+};
+
+// スレッドごとのバッファ, 記録中はロックを取らない
+// スレッドが終了しても書き出せるように、バッファ自体はTraceRegistryが持つ
+struct TraceBuffer {
+  int tid;
+  std::vector<TraceEvent> events;
+};
+
+struct TraceRegistry {
+  const steady_clock::time_point origin = steady_clock::now();
+
+  TraceBuffer *create_buffer(){
+    std::lock_guard<std::mutex> lock(mtx);
+    buffers.emplace_back(new TraceBuffer{ (int)buffers.size(), {} });
+    buffers.back()->events.reserve(1 << 12);
+    return buffers.back().get();
+  }
+  // 記録中のスレッドがない時に呼ぶ
+  void dump(const char *path){
+    std::lock_guard<std::mutex> lock(mtx);
+    std::FILE *fp = std::fopen(path, "w");
+    if(!fp) return;
+    std::fprintf(fp, "{\"traceEvents\":[\n");
+    bool first = true;
+    for(const auto &buf : buffers){
+      for(const auto &e : buf->events){
+        std::fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":0,\"tid\":%d}",
+                     first ? "" : ",\n", e.name, e.begin_us, e.dur_us, buf->tid);
+        first = false;
+      }
+    }
+    std::fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    std::fclose(fp);
+  }
+  inline long long now_us() const noexcept{
+    return std::chrono::duration_cast<std::chrono::microseconds>(steady_clock::now() - origin).count();
+  }
+
+private:
+  std::mutex mtx;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+};
+TraceRegistry trace_registry;
+
+inline TraceBuffer &local_trace_buffer(){
+  thread_local TraceBuffer *buf = trace_registry.create_buffer();
+  return *buf;
+}
+
+struct TraceScope {
+  explicit TraceScope(const char *_name) : name(_name), begin_us(trace_registry.now_us()){}
+  ~TraceScope(){ close(); }
+  void close(){
+    if(!name) return;
+    const long long end_us = trace_registry.now_us();
+    local_trace_buffer().events.push_back({ name, begin_us, end_us - begin_us });
+    name = nullptr;
+  }
+  TraceScope(const TraceScope&) = delete;
+  TraceScope &operator=(const TraceScope&) = delete;
+
+private:
+  const char *name;
+  const long long begin_us;
+};
+
+#define TRACE_EVENT_VAR(var, name) TraceScope var(name)
+#define TRACE_EVENT_CLOSE(var) var.close()
+inline void dump_trace(const char *path = TRACEFILE){ trace_registry.dump(path); }
+
+#else
+#define TRACE_EVENT_VAR(var, name) ((void)0)
+#define TRACE_EVENT_CLOSE(var) ((void)0)
+inline void dump_trace(const char * = nullptr){}
+#endif
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TRACE_SCOPE_VAR(TRACE_CONCAT(trace_scope_, __LINE__), name)
+#define TRACE_SCOPE_VAR(var, name) TRACE_EVENT_VAR(var, name); ALLOC_PHASE_VAR(TRACE_CONCAT(var, _alloc), name)
+#define TRACE_CLOSE(var) TRACE_EVENT_CLOSE(var); ALLOC_PHASE_CLOSE(TRACE_CONCAT(var, _alloc))
@@ -2,6 +2,7 @@
 
 #include <tuple>
 #include <map>
+#include <queue>
 #include <cmath>
 #include "base.hpp"
 #include "timer.hpp"
@@ -14,20 +15,22 @@ constexpr int inf = 1024;
 // 距離: 初手にたどり着くことができる職人を除いたグリッド上での移動距離
 // 敵の壁がある場合は+1される
 // 池がには入れない
+// dist, prevの添字はto_cell
+template <class B>
 void calc_move_min_cost(const Point start, const Field &field, const State enemy_wall, std::vector<int> &dist, std::vector<int> &prev){
-  static std::priority_queue<std::pair<int,Point>> que;
+  static std::priority_queue<std::pair<int,int>, std::vector<std::pair<int,int>>, std::greater<std::pair<int,int>>> que;
 
-  dist.assign(height*width, inf);
-  prev.assign(height*width, -1);
+  dist.assign(B::cell_size(), inf);
+  prev.assign(B::cell_size(), -1);
   
   // 0手目
-  dist[to_idx(start)] = 0;
+  const int start_c = to_cell(start);
+  dist[start_c] = 0;
 
   // 1手目
   for(int i = 0; i < 8; i++){
-    const Point nxt = start + dmove[i];
-    if(!is_valid(nxt)) continue;
-    const State st = field.get_state(nxt);
+    const int nxt = start_c + dcell[i];
+    const State st = field.get_cell(nxt);
     if(st & (State::Pond | State::Human)) continue;
     int weight = 0;
     if(i < 4){
@@ -37,21 +40,20 @@ void calc_move_min_cost(const Point start, const Field &field, const State enemy
       if(st & enemy_wall) continue;
       weight++;
     }
-    dist[to_idx(nxt)] = weight;
-    prev[to_idx(nxt)] = to_idx(start);
+    dist[nxt] = weight;
+    prev[nxt] = start_c;
     que.emplace(weight, nxt);
   }
   
   // 2手目~
   while(!que.empty()){
-    int cost; Point p;
+    int cost, p;
     std::tie(cost, p) = que.top();
     que.pop();
-    if(dist[to_idx(p)] < cost) continue;
+    if(dist[p] < cost) continue;
     for(int k = 0; k < 8; k++){
-      const Point nxt = p + dmove[k];
-      if(!is_valid(nxt)) continue;
-      const State st = field.get_state(nxt);
+      const int nxt = p + dcell[k];
+      const State st = field.get_cell(nxt);
 
       if(st & State::Pond) continue;
       int weight = 0;
@@ -62,35 +64,41 @@ void calc_move_min_cost(const Point start, const Field &field, const State enemy
         if(st & enemy_wall) continue;
         weight++;
       }
-      if(chmin(dist[to_idx(nxt)], cost + weight)){
-        prev[to_idx(nxt)] = to_idx(p);
+      if(chmin(dist[nxt], cost + weight)){
+        prev[nxt] = p;
         que.emplace(cost+weight, nxt);
       }
     }
   }
 }
+void calc_move_min_cost(const Point start, const Field &field, const State enemy_wall, std::vector<int> &dist, std::vector<int> &prev){
+  TRACE_SCOPE("calc_move_min_cost");
+  with_board([&](auto board){ calc_move_min_cost<decltype(board)>(start, field, enemy_wall, dist, prev); });
+}
 
 // 距離: 職人を除いたグリッド上での移動距離
 // 敵の壁がある場合は+1される
 // 池が目的地の場合、その時だけ上下左右から入れるとする
+// dist, prevの添字はto_cell
+template <class B>
 void calc_move_min_cost_except_human(const Point start, const Field &field, const State enemy_wall, std::vector<int> &dist, std::vector<int> &prev){
-  static std::priority_queue<std::pair<int,Point>> que;
+  static std::priority_queue<std::pair<int,int>, std::vector<std::pair<int,int>>, std::greater<std::pair<int,int>>> que;
 
-  dist.assign(height*width, inf);
-  prev.assign(height*width, -1);
+  dist.assign(B::cell_size(), inf);
+  prev.assign(B::cell_size(), -1);
   
-  dist[to_idx(start)] = 0;
-  que.emplace(0, start);
+  const int start_c = to_cell(start);
+  dist[start_c] = 0;
+  que.emplace(0, start_c);
   
   while(!que.empty()){
-    int cost; Point p;
+    int cost, p;
     std::tie(cost, p) = que.top();
     que.pop();
-    if(dist[to_idx(p)] < cost) continue;
+    if(dist[p] < cost) continue;
     for(int k = 0; k < 8; k++){
-      const Point nxt = p + dmove[k];
-      if(!is_valid(nxt)) continue;
-      const State st = field.get_state(nxt);
+      const int nxt = p + dcell[k];
+      const State st = field.get_cell(nxt);
 
       int weight = 0;
       if(k < 4){
@@ -100,8 +108,8 @@ void calc_move_min_cost_except_human(const Point start, const Field &field, cons
         if(st & (State::Pond | enemy_wall)) continue;
         weight++;
       }
-      if(chmin(dist[to_idx(nxt)], cost + weight)){
-        prev[to_idx(nxt)] = to_idx(p);
+      if(chmin(dist[nxt], cost + weight)){
+        prev[nxt] = p;
         if(!(st & State::Pond)){
           que.emplace(cost+weight, nxt);
         }
@@ -109,6 +117,10 @@ void calc_move_min_cost_except_human(const Point start, const Field &field, cons
     }
   }
 }
+void calc_move_min_cost_except_human(const Point start, const Field &field, const State enemy_wall, std::vector<int> &dist, std::vector<int> &prev){
+  TRACE_SCOPE("calc_move_min_cost_except_human");
+  with_board([&](auto board){ calc_move_min_cost_except_human<decltype(board)>(start, field, enemy_wall, dist, prev); });
+}
 
 
 
@@ -119,20 +131,22 @@ struct CostTable {
 
   inline int get_cost(const Point from, const Point to, const bool not_in_hum=false){
     const int idx = to_idx(from);
-    std::vector<int> prev;
-    if(!not_in_hum){
-      if(data[idx].empty()){
-        calc_move_min_cost(from, field, enemy_wall, data[idx], prev);
-      }
-      return data[idx][to_idx(to)];
-    }else{
-      if(data2[idx].empty()){
-        calc_move_min_cost_except_human(from, field, enemy_wall, data2[idx], prev);
-      }
-      return data2[idx][to_idx(to)];
+    auto &dist = not_in_hum ? data2[idx] : data[idx];
+    lookups++;
+    if(dist.empty()){
+      StopWatch sw;
+      std::vector<int> prev;
+      if(!not_in_hum) calc_move_min_cost(from, field, enemy_wall, dist, prev);
+      else calc_move_min_cost_except_human(from, field, enemy_wall, dist, prev);
+      misses++;
+      fill_ms += sw.get_ms();
     }
+    return dist[to_cell(to)];
   }
 
+  ll lookups = 0, misses = 0; // get_costの回数, そのうち計算した回数
+  double fill_ms = 0; // 計算にかかった時間[ms]
+
 private:
   std::vector<std::vector<int>> data, data2;
   const State enemy_wall;
@@ -280,10 +294,10 @@ Action get_first_action(const Agent agent, const Wall first_wall, const int dir,
   // build or break
   if(agent == target){
     if(field.get_state(first_wall) & enemy_wall){
-      return Action(first_wall, Action::Break);
+      return Action(Action::Break, to_dir(agent, first_wall));
     }else{
       assert(!(field.get_state(first_wall) & State::Wall));
-      return Action(first_wall, Action::Build);
+      return Action(Action::Build, to_dir(agent, first_wall));
     }
   }
 
@@ -291,20 +305,21 @@ Action get_first_action(const Agent agent, const Wall first_wall, const int dir,
   
   calc_move_min_cost(agent, field, enemy_wall, dist, prev);
 
-  assert(dist[to_idx(target)] < inf);
+  assert(dist[to_cell(target)] < inf);
 
-  int nxt_pos = to_idx(target);
-  while(prev[nxt_pos] != to_idx(agent)){
+  int nxt_pos = to_cell(target);
+  while(prev[nxt_pos] != to_cell(agent)){
     nxt_pos = prev[nxt_pos];
   }
-  const Point nxt = to_point(nxt_pos);
+  const Point nxt = cell_to_point(nxt_pos);
   assert(is_around(agent, nxt));
-  return Action(nxt, Action::Move);
+  return Action(Action::Move, to_dir(agent, nxt));
 }
 
 
-Actions calculate_build_route(const Walls &build_walls, const Field &field){
-  const int TL = field.TL * 0.67;
+// ctx.deadlineまで焼きなましを行い、改善したらctx.emitに暫定の手を渡す
+Actions calculate_build_route(const Walls &build_walls, const Field &field, const SearchContext &ctx){
+  TRACE_SCOPE("calculate_build_route");
   const auto &agents = field.get_now_turn_agents();
   const int agents_num = agents.size();
   const State ally = field.get_state(agents[0]) & State::Human; // agentから見た味方
@@ -315,9 +330,15 @@ Actions calculate_build_route(const Walls &build_walls, const Field &field){
   const State ally_wall = ally == State::Ally ? State::WallAlly : State::WallEnemy; // agentから見た味方のwall
   const State enemy_wall = ally_wall ^ State::Wall; // agentから見た敵のwall
 
-  StopWatch sw;
-
+  SearchStats stats;
+  StopWatch phase_sw;
   CostTable cost_table(field, enemy_wall);
+  const auto write_stats = [&]{
+    stats.cost_lookups = cost_table.lookups;
+    stats.cost_misses = cost_table.misses;
+    stats.cost_table_ms = cost_table.fill_ms;
+    if(ctx.stats) *ctx.stats = stats;
+  };
 
   // すでに置いた壁をなくす
   Walls walls;
@@ -329,11 +350,14 @@ Actions calculate_build_route(const Walls &build_walls, const Field &field){
     cerr << "Wall is none\n";
     Actions result;
     for(int i = 0; i < agents_num; i++){
-      result.emplace_back(Action(Point(), Action::None, i));
+      result.emplace_back(Action(Action::None, 0, i));
     }
+    write_stats();
+    if(ctx.routes) ctx.routes->assign(agents_num, Walls());
     return result;
   }
 
+  TRACE_SCOPE_VAR(partition_trace, "partition");
   std::vector<Walls> wall_part(agents_num);
   const int max_parts_num = (walls_num + agents_num-1) / agents_num;
   for(const Wall wall : walls){
@@ -350,21 +374,39 @@ Actions calculate_build_route(const Walls &build_walls, const Field &field){
         }
       }
     }
-    cerr << "wall: " << wall << "\n";
+    cdebug << "wall: " << wall << "\n";
     assert(best_idx != -1);
     wall_part[best_idx].emplace_back(wall);
   }
+  stats.partition_ms = phase_sw.lap_ms();
+  TRACE_CLOSE(partition_trace);
   
   for(int i = 0; i < agents_num; i++){
     if(!wall_part[i].empty()){
+      TRACE_SCOPE("calc_tsp_route");
       wall_part[i] = calc_tsp_route(agents[i], wall_part[i], cost_table);
     }
   }
 
+  // 各職人の最初の行動
+  const auto make_actions = [&](const std::vector<Walls> &parts){
+    TRACE_SCOPE("make_actions");
+    Actions result;
+    for(int i = 0; i < agents_num; i++){
+      if(!parts[i].empty()){
+        const int dir = find_agent_build_wall_dir(agents[i], parts[i], field, cost_table);
+        result.emplace_back(get_first_action(agents[i], parts[i][0], dir, field, enemy_wall));
+      }else{
+        result.emplace_back(Action(Action::None));
+      }
+      result.back().set_agent_idx(i);
+    }
+    return result;
+  };
+
   const double T0 = walls_num / 10.0;
   const double T1 = 1;
   double temp = T0;
-  double spend_time = 0;
   auto best_wall_part = wall_part;
   std::vector<int> costs(agents_num);
   int best_score = 0;
@@ -374,16 +416,25 @@ Actions calculate_build_route(const Walls &build_walls, const Field &field){
   }
   auto awesome_wall_part = best_wall_part;
   int awesome_score = best_score;
+  stats.tsp_ms = phase_sw.lap_ms();
+  bool emit_pending = false; // まだemitしていない改善があるか
+  if(ctx.emit) ctx.emit_best(make_actions(awesome_wall_part));
 
   cerr << "Start SA(TSP)\n";
   cerr << "First Score: " << awesome_score << "\n";
-  int steps = 0, updated_num = 0;
-  for(; ; steps++){
+  stats.first_cost = awesome_score;
+  int steps = 0, updated_num = 0, improved_num = 0;
+  TRACE_SCOPE_VAR(sa_trace, "sa");
+  ll evals = agents_num;
+  for(; steps < ctx.max_steps; steps++){
     if(!(steps & 127)){
-      spend_time = sw.get_ms();
-      const double p = spend_time / TL;
+      const double p = ctx.deadline.progress();
       if(p >= 1.0) break;
       temp = (T1 - T0) * p + T0;
+      if(emit_pending){
+        ctx.emit_best(make_actions(awesome_wall_part));
+        emit_pending = false;
+      }
     }
 
     auto wp = wall_part;
@@ -431,6 +482,7 @@ Actions calculate_build_route(const Walls &build_walls, const Field &field){
         chmax(score, costs[i]);
       }
     }
+    evals += a == b ? 1 : 2;
 
     if(awesome_score > score){
       awesome_score = score;
@@ -441,6 +493,9 @@ Actions calculate_build_route(const Walls &build_walls, const Field &field){
       costs[a] = calc_agent_move_cost(agents[a], wp[a], field, cost_table);
       costs[b] = calc_agent_move_cost(agents[b], wp[b], field, cost_table);
       updated_num++;
+      improved_num++;
+      evals += 2;
+      emit_pending = (bool)ctx.emit;
     }else if(exp((double)(best_score - score) / temp) > rnd(2048)/2048.0){
       best_score = score;
       best_wall_part = wp;
@@ -448,29 +503,37 @@ Actions calculate_build_route(const Walls &build_walls, const Field &field){
       costs[a] = calc_agent_move_cost(agents[a], wp[a], field, cost_table);
       costs[b] = calc_agent_move_cost(agents[b], wp[b], field, cost_table);
       updated_num++;
+      evals += 2;
     }
   }
   cerr << "Steps: " << steps << "\n";
   cerr << "Updated: " << updated_num << "\n";
   cerr << "Final Score: " << awesome_score << "\n";
-
-  wall_part = awesome_wall_part;
-
-  Actions result;
-  for(int i = 0; i < agents_num; i++){
-    if(!wall_part[i].empty()){
-      const int dir = find_agent_build_wall_dir(agents[i], wall_part[i], field, cost_table);
-      result.emplace_back(get_first_action(agents[i], wall_part[i][0], dir, field, enemy_wall));
-    }else{
-      result.emplace_back(Action(Point(), Action::None));
-    }
-  }
-  for(int i = 0; i < agents_num; i++){
-    result[i].agent_idx = i;
-  }
+  stats.sa_ms = phase_sw.lap_ms();
+  TRACE_CLOSE(sa_trace);
+  stats.sa_steps = steps;
+  stats.sa_accepted = updated_num;
+  stats.sa_improved = improved_num;
+  stats.evals = evals;
+  stats.final_cost = awesome_score;
+
+  const Actions result = make_actions(awesome_wall_part);
+  stats.extract_ms = phase_sw.lap_ms();
+  write_stats();
+  if(ctx.routes) *ctx.routes = awesome_wall_part;
   return result;
 }
 
+// 今から1ターンの持ち時間(field.TL)を使える場合
+// max_steps: SAの最大ステップ数(再現性のある計測用)
+Actions calculate_build_route(const Walls &build_walls, const Field &field, const int max_steps=1<<30){
+  TimeManager time_manager(field.TL);
+  time_manager.start_turn();
+  SearchContext ctx(time_manager.deadline());
+  ctx.max_steps = max_steps;
+  return calculate_build_route(build_walls, field, ctx);
+}
+
 };
 
 using TSP::calculate_build_route;
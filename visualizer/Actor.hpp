@@ -1,6 +1,7 @@
 ﻿# pragma once
 # include <Siv3D.hpp>
 # include "Field.hpp"
+# include "Protocol.hpp"
 
 
 class Craftsman {
@@ -17,9 +18,11 @@ public:
 	// 職人の移動
 	bool move(Field &field, const Point direction);
 	// 行動情報の出力
-	void output_act(ChildProcess &child) const;
-	// 行動情報を受け取って動かす
-	void input_act(ChildProcess &child, Field &field);
+	void output_act(std::ostream &os) const;
+	// 行動情報を受け取る(盤面には反映しない)
+	void read_act(std::istream &is);
+	// read_actで受け取った行動で動かす
+	void apply_act(Field &field);
 
 // private:
 	// 職人の座標
@@ -63,10 +66,8 @@ bool Craftsman::build(Field &field, const Point direction_point){
 		return false;
 	}
 	const CELL target_cell = field.get_cell(target_cell_pos);
-	// 建設可能な場所か
-	if(target_cell & CELL::WALL or
-		target_cell & switch_cell(CELL::CRAFTSMAN, not team) or
-		target_cell & CELL::CASTLE){
+	// 建設可能な場所か(自分の城壁があるマスにも建てない)
+	if(target_cell & (CELL::WALL | CELL(Rules::build_blocker(team)))){
 		return false;
 	}
 	// フィールド変化
@@ -93,7 +94,7 @@ bool Craftsman::destroy(Field &field, const Point direction_point){
 	}
 	const CELL target_cell = field.get_cell(target_cell_pos);
 	// 破壊可能な場所か
-	if(not (target_cell & CELL::WALL)){
+	if(not (target_cell & CELL(Rules::break_target))){
 		return false;
 	}
 	// フィールド変化
@@ -120,9 +121,7 @@ bool Craftsman::move(Field &field, const Point direction_point){
 	}
 	// 移動可能な場所か
 	const CELL target_cell = field.get_cell(target_cell_pos);
-	if((target_cell & CELL::POND) or
-		(target_cell & switch_cell(CELL::WALL, not team)) or
-		(target_cell & CELL::CRAFTSMAN)){
+	if(target_cell & CELL(Rules::move_blocker(team))){
 		return false;
 	}
 	// フィールド変化
@@ -142,32 +141,52 @@ bool Craftsman::move(Field &field, const Point direction_point){
 	return true;
 }
 
-void Craftsman::output_act(ChildProcess &child) const {
-	child.ostream() << direction << std::endl;
+void Craftsman::output_act(std::ostream &os) const {
+	if(SOLVER_PROTOCOL == PROTOCOL::BINARY){
+		write_digits(os, (direction << 2) | (int)act, 1);
+		return;
+	}
+	os << direction << std::endl;
 	if(act == ACT::BUILD){
-		child.ostream() << "build" << std::endl;
+		os << "build" << std::endl;
 	}else if(act == ACT::DESTROY){
-		child.ostream() << "break" << std::endl;
+		os << "break" << std::endl;
 	}else if(act == ACT::MOVE){
-		child.ostream() << "move" << std::endl;
+		os << "move" << std::endl;
 	}else{
-		child.ostream() << "none" << std::endl;
+		os << "none" << std::endl;
 	}
 }
 
-void Craftsman::input_act(ChildProcess &child, Field &field){
-	int direction_num;
-	std::string act_str;
-	child.istream() >> direction_num >> act_str;
-	const Point direction_point = range_move[direction_num];
-	if(act_str == "move"){
-		this->act = ACT::MOVE;
+void Craftsman::read_act(std::istream &is){
+	int direction_num = 0;
+	ACT act_type = ACT::NOTHING;
+	if(SOLVER_PROTOCOL == PROTOCOL::BINARY){
+		const int v = read_digits(is, 1);
+		direction_num = (v >> 2) & 7;
+		act_type = (ACT)(v & 3);
+	}else{
+		std::string act_str;
+		is >> direction_num >> act_str;
+		if(act_str == "move"){
+			act_type = ACT::MOVE;
+		}else if(act_str == "build"){
+			act_type = ACT::BUILD;
+		}else if(act_str == "break"){
+			act_type = ACT::DESTROY;
+		}
+	}
+	this->direction = direction_num;
+	this->act = act_type;
+}
+
+void Craftsman::apply_act(Field &field){
+	const Point direction_point = range_move[direction];
+	if(act == ACT::MOVE){
 		move(field, direction_point);
-	}else if(act_str == "build"){
-		this->act = ACT::BUILD;
+	}else if(act == ACT::BUILD){
 		build(field, direction_point);
-	}else if(act_str == "break"){
-		this->act = ACT::DESTROY;
+	}else if(act == ACT::DESTROY){
 		destroy(field, direction_point);
 	}
 }
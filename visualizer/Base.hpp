@@ -1,5 +1,6 @@
 ﻿# pragma once
 # include <Siv3D.hpp>
+# include "../solver/rules.hpp"
 
 // フィールドの縦横
 int HEIGHT;
@@ -52,6 +53,11 @@ constexpr CELL CELL::CASTLE = 1 << 7;
 constexpr CELL CELL::CRAFTSMAN = CELL::CRAFTSMAN_BLUE | CELL::CRAFTSMAN_RED;
 constexpr CELL CELL::WALL = CELL::WALL_BLUE | CELL::WALL_RED;
 constexpr CELL CELL::AREA = CELL::AREA_BLUE | CELL::AREA_RED;
+// ルールの処理はsolverと共通のRules(../solver/rules.hpp)で行うので、bitの並びを合わせる(チーム0 = 赤, チーム1 = 青)
+static_assert(CELL::WALL_RED == CELL(Rules::wall(0)) and CELL::WALL_BLUE == CELL(Rules::wall(1)));
+static_assert(CELL::AREA_RED == CELL(Rules::area(0)) and CELL::AREA_BLUE == CELL(Rules::area(1)));
+static_assert(CELL::CRAFTSMAN_RED == CELL(Rules::mason(0)) and CELL::CRAFTSMAN_BLUE == CELL(Rules::mason(1)));
+static_assert(CELL::POND == CELL(Rules::Pond) and CELL::CASTLE == CELL(Rules::Castle));
 
 struct TEAM {
 	static const TEAM RED;
@@ -74,6 +80,12 @@ enum class ACT {
 };
 
 
+// Rulesに渡す盤面の大きさ
+struct FieldSize {
+	int h(void) const { return HEIGHT; }
+	int w(void) const { return WIDTH; }
+};
+
 bool is_in_field(const int y, const int x){
 	return 0 <= y and y < HEIGHT and 0 <= x and x < WIDTH;
 }
@@ -138,12 +138,18 @@ struct MatchStatus {
 
 	MatchStatus(){}
 
-	MatchStatus(const JSON &json){
+	// logsはsince_turnより後のターンのものだけを作る(logsは試合が進むほど長くなるので)
+	MatchStatus(const JSON &json, const int since_turn = 0){
 		this->id = json[U"id"].get<int>();
 		this->turn = json[U"turn"].get<int>();
 		this->board = MatchStatusBoard(json[U"board"]);
-		for(const MatchStatusLog &matchstatuslog : json[U"logs"].arrayView()){
-			logs << matchstatuslog;
+		const JSON &json_logs = json[U"logs"];
+		size_t begin = json_logs.size();
+		while(begin > 0 and json_logs[begin - 1][U"turn"].get<int>() > since_turn){
+			begin--;
+		}
+		for(size_t i = begin; i < json_logs.size(); i++){
+			logs << MatchStatusLog(json_logs[i]);
 		}
 	}
 };
@@ -205,8 +211,8 @@ public:
 	Connect(void);
 	// 試合一覧取得
 	Optional<MatchDataMatch> get_matches_list(void);
-	// 試合状況取得
-	Optional<MatchStatus> get_match_status(void);
+	// 試合状況取得(logsはsince_turnより後のターンのものだけ)
+	Optional<MatchStatus> get_match_status(const int since_turn = 0);
 	// 行動計画更新
 	Optional<int> post_action_plan(const ActionPlan &action);
 };
@@ -222,6 +228,119 @@ void output_console_json(const JSON &json){
 	Console << json.format();
 }
 
+// 応答の本文(UTF-8)
+std::string_view get_response_body(const MemoryWriter &writer){
+	const Blob &blob = writer.getBlob();
+	return std::string_view{ reinterpret_cast<const char*>(blob.data()), blob.size() };
+}
+
+// 応答の本文をファイルを介さずにJSONとして読む
+JSON parse_response_body(const MemoryWriter &writer){
+	return JSON::Parse(Unicode::FromUTF8(get_response_body(writer)));
+}
+
+// 本文のトップレベルの"logs"の配列の位置(byte位置の[begin, end))
+struct LogsSpan {
+	// '['から']'まで
+	size_t begin = 0;
+	size_t end = 0;
+	// 各要素
+	Array<std::pair<size_t, size_t>> elements;
+};
+
+// JSONとして読まずに、文字列の中を除いて括弧の深さだけを数えて"logs"の配列を探す
+Optional<LogsSpan> find_logs_span(const std::string_view body){
+	constexpr size_t npos = std::string_view::npos;
+	LogsSpan span;
+	int depth = 0;
+	bool in_string = false, escaped = false, in_logs = false;
+	size_t string_begin = 0, element_begin = npos;
+	std::string_view last_string, key;
+	for(size_t i = 0; i < body.size(); i++){
+		const char c = body[i];
+		if(in_string){
+			if(escaped){
+				escaped = false;
+			}
+			else if(c == '\\'){
+				escaped = true;
+			}
+			else if(c == '"'){
+				in_string = false;
+				last_string = body.substr(string_begin, i - string_begin);
+			}
+			continue;
+		}
+		if(in_logs and depth == 2 and element_begin == npos and c != ',' and c != ']' and not IsSpace(c)){
+			element_begin = i;
+		}
+		switch(c){
+		case '"':
+			in_string = true;
+			string_begin = i + 1;
+			break;
+		case ':':
+			if(depth == 1){
+				key = last_string;
+			}
+			break;
+		case '{':
+		case '[':
+			if(depth == 1 and c == '[' and key == "logs"){
+				in_logs = true;
+				span.begin = i;
+			}
+			depth++;
+			break;
+		case '}':
+		case ']':
+			depth--;
+			if(in_logs and depth == 1){
+				if(element_begin != npos){
+					span.elements.emplace_back(element_begin, i);
+				}
+				span.end = i + 1;
+				return span;
+			}
+			break;
+		case ',':
+			if(in_logs and depth == 2 and element_begin != npos){
+				span.elements.emplace_back(element_begin, i);
+				element_begin = npos;
+			}
+			break;
+		}
+	}
+	return none;
+}
+
+// 試合状況を読む(logsはsince_turnより後のターンのものだけ)
+// logsは試合が進むほど長くなるので、本文全体はJSON::Parseしない
+// logsの配列を除いた部分だけを読み、logsは後ろの要素から1つずつ読んでsince_turn以前のものに当たったらやめる
+MatchStatus parse_match_status(const std::string_view body, const int since_turn){
+	const Optional<LogsSpan> span = find_logs_span(body);
+	if(not span){
+		return MatchStatus(JSON::Parse(Unicode::FromUTF8(body)), since_turn);
+	}
+	std::string rest;
+	rest.reserve(body.size() - (span->end - span->begin) + 2);
+	rest.append(body.substr(0, span->begin));
+	rest.append("[]");
+	rest.append(body.substr(span->end));
+	MatchStatus status(JSON::Parse(Unicode::FromUTF8(rest)), since_turn);
+	Array<MatchStatusLog> logs;
+	for(size_t i = span->elements.size(); i > 0; i--){
+		const auto [begin, end] = span->elements[i - 1];
+		const JSON log = JSON::Parse(Unicode::FromUTF8(body.substr(begin, end - begin)));
+		if(log[U"turn"].get<int>() <= since_turn){
+			break;
+		}
+		logs << MatchStatusLog(log);
+	}
+	status.logs = logs.reversed();
+	return status;
+}
+
 void output_console_fail(const String &str){
 	Console << U"------";
 	Console << str << U" failed!!";
@@ -247,12 +366,13 @@ Connect::Connect(void){
 
 Optional<MatchDataMatch> Connect::get_matches_list(void){
 	const URL url = url_base + U"matches" + U"?token=" + token;
-	const FilePath saveFilePath = U"./mathes_list.json";
-	if(const auto response = SimpleHTTP::Get(url, headers, saveFilePath)){
+	MemoryWriter writer;
+	if(const auto response = SimpleHTTP::Get(url, headers, writer)){
 		output_console_response(response);
 		if(response.isOK()){
-			output_console_json(JSON::Load(saveFilePath));
-			const MatchData matchdata = MatchData(JSON::Load(saveFilePath));
+			const JSON json = parse_response_body(writer);
+			output_console_json(json);
+			const MatchData matchdata = MatchData(json);
 			for(const MatchDataMatch &matchdatamatch : matchdata.matches){
 				if(matchdatamatch.id == this->match_id){
 					return matchdatamatch;
@@ -266,14 +386,13 @@ Optional<MatchDataMatch> Connect::get_matches_list(void){
 	return none;
 }
 
-Optional<MatchStatus> Connect::get_match_status(void){
+Optional<MatchStatus> Connect::get_match_status(const int since_turn){
 	const URL url = url_base + U"matches/" + Format(match_id) + U"?token=" + token;
-	const FilePath saveFilePath = U"./match_status.json";
-	if(const auto response = SimpleHTTP::Get(url, headers, saveFilePath)){
+	MemoryWriter writer;
+	if(const auto response = SimpleHTTP::Get(url, headers, writer)){
 		//output_console_response(response);
 		if(response.isOK()){
-			//output_console_json(JSON::Load(saveFilePath));
-			return MatchStatus(JSON::Load(saveFilePath));
+			return parse_match_status(get_response_body(writer), since_turn);
 		}
 	}else{
 		output_console_fail(U"get_match_status");
@@ -283,13 +402,14 @@ Optional<MatchStatus> Connect::get_match_status(void){
 
 Optional<int> Connect::post_action_plan(const ActionPlan &actionplan){
 	const URL url = url_base + U"matches/" + Format(match_id) + U"?token=" + token;
-	const FilePath saveFilePath = U"./tmp.json";
 	const std::string data = actionplan.output_json().formatUTF8();
-	if(const auto response = SimpleHTTP::Post(url, headers, data.data(), data.size(), saveFilePath)){
+	MemoryWriter writer;
+	if(const auto response = SimpleHTTP::Post(url, headers, data.data(), data.size(), writer)){
 		output_console_response(response);
 		if(response.isOK()){
-			output_console_json(JSON::Load(saveFilePath));
-			return (JSON::Load(saveFilePath))[U"accepted_at"].get<int>();
+			const JSON json = parse_response_body(writer);
+			output_console_json(json);
+			return json[U"accepted_at"].get<int>();
 		}else{
 			output_console_fail(U"post_action_plan");
 		}
@@ -1,6 +1,7 @@
 ﻿# pragma once
 # include <Siv3D.hpp> // OpenSiv3D v0.6.10
 # include "Game.hpp"
+# include "Poller.hpp"
 
 
 // solver.exe対サーバー
@@ -13,6 +14,8 @@ public:
 private:
 	// 通信を行うクラス
 	Connect connect;
+	// 試合状況を別スレッドで取得する(connectより後に破棄する)
+	std::unique_ptr<MatchStatusPoller> poller;
 	// 通信を行う際に使用する構造体
 	MatchDataMatch matchdatamatch;
 	MatchStatus matchstatus;
@@ -21,12 +24,16 @@ private:
 	int match_id = 0;
 	// solver.exeが先手か
 	bool is_first = false;
-	// ストップウォッチ
-	Stopwatch stopwatch;
+	// このターンにsolver.exeから最後に受け取った行動
+	Array<Craftsman> solver_acts;
+	// 最後にサーバーへ送った行動計画
+	String posted_plan;
 	// 試合を開始する
 	void execute_match(void);
 	// 職人の行動をActionPlanに変換
-	ActionPlan team2actionplan(const TEAM team);
+	ActionPlan acts2actionplan(const Array<Craftsman> &acts) const;
+	// solver_actsを前回送ったものから変わっていればサーバーに送る
+	void post_solver_acts(void);
 	//  MatchStatusから職人情報を上塗り
 	void set_craftsman(Array<Craftsman> &tmp_craftsmen, const int turn);
 	// server.exe, serverのターンの処理
@@ -57,6 +64,7 @@ CvC::CvC(const InitData &init) : IScene(init){
 		now_turn = TEAM::BLUE;
 	}
 	time = matchdatamatch.turnSeconds * 1000;
+	poller = std::make_unique<MatchStatusPoller>(connect, time);
 	turn_num = matchdatamatch.turns;
 
 	for(Array<Craftsman> &craftsmen_ary : craftsmen){
@@ -77,14 +85,24 @@ CvC::CvC(const InitData &init) : IScene(init){
 }
 
 
-ActionPlan CvC::team2actionplan(const TEAM team){
+ActionPlan CvC::acts2actionplan(const Array<Craftsman> &acts) const {
 	ActionPlan tmp_actionplan(turn_num_now + 1);
-	for(const Craftsman& craftsman : craftsmen[team]){
+	for(const Craftsman& craftsman : acts){
 		tmp_actionplan.push_back_action((int)craftsman.act, to_direction_server(craftsman.direction) + 1);
 	}
 	return tmp_actionplan;
 }
 
+void CvC::post_solver_acts(void){
+	const ActionPlan plan = acts2actionplan(solver_acts);
+	const String json = plan.output_json().formatMinimum();
+	if(json == posted_plan){
+		return;
+	}
+	posted_plan = json;
+	connect.post_action_plan(plan);
+}
+
 void CvC::set_craftsman(Array<Craftsman> &tmp_craftsmen, const int turn){
 	for(const MatchStatusLog &log : matchstatus.logs){
 		if (log.turn != turn) continue;
@@ -134,30 +152,36 @@ void CvC::execute_match(void){
 }
 
 bool CvC::turn_solver(void){
-	if(not stopwatch.isStarted()){
-		stopwatch.start();
-		return false;
-	}else{
-		if(stopwatch.ms() < time * 0.9){
-			return false;
-		}else{
-			stopwatch.reset();
+	// solver.exeから届いた行動のうち最新のものを、前回から変わっていればすぐに送る
+	// (最初の暫定の行動を早めに送っておき、締め切り間際の通信の遅れに備える)
+	bool is_received = false, is_final = false;
+	while(Optional<SolverMessage> message = solver->pop()){
+		solver_acts = std::move(message->acts);
+		is_received = true;
+		if(message->is_final){
+			is_final = true;
+			break;
 		}
 	}
-	// solver.exeから行動情報を受け取る
-	receive_solver(TEAM::RED, getData());
-	connect.post_action_plan(team2actionplan(TEAM::RED));
+	if(is_received){
+		post_solver_acts();
+	}
+	if(not is_final){
+		return false;
+	}
+	apply_solver_acts(TEAM::RED, solver_acts, getData());
 	turn_num_now++;
 	now_turn = TEAM::BLUE;
 	return true;
 }
 
 bool CvC::turn_server(void){
-	// 次のターンが来るまで待機
+	// 次のターンが来るまで待機(届いたもののうち最新の試合状況を使う)
 	Optional<MatchStatus> tmp_matchstatus;
-	tmp_matchstatus = connect.get_match_status();
+	while(Optional<MatchStatus> status = poller->pop()){
+		tmp_matchstatus = std::move(status);
+	}
 	if(tmp_matchstatus == none){
-		Console << U"Cannot get match status! \t get again now ...";
 		return false;
 	}else if(tmp_matchstatus.value().turn != turn_num_now + 1){
 		Console << U"this turn is server's";
@@ -170,6 +194,8 @@ bool CvC::turn_server(void){
 	getData().update(matchstatus);
 	// 職人情報更新
 	set_craftsman(craftsmen[TEAM::BLUE], turn_num_now);
+	// solver.exeにサーバーの盤面を渡す(失敗した行動などによるずれを直す)
+	give_solver_snapshot(TEAM::RED, matchstatus.board);
 	// solver.exeに行動情報を渡す
 	give_solver(TEAM::RED);
 	// solver.exeに建築予定の壁を渡す
@@ -191,16 +217,17 @@ void CvC::display_field(void) const {
 			}
 		}
 	}
+	display_solver_insight(TEAM::RED);
 }
 
 void CvC::update(){
 	execute_match();
+	receive_solver_insight();
 	receive_build_plan(getData());
 }
 
 void CvC::draw() const {
-	getData().display_actors();
+	getData().display_board();
 	display_field();
-	getData().display_grid();
 	display_details(getData());
 }
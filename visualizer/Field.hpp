@@ -17,15 +17,40 @@ Circle get_grid_circle(const Point p){
 	return Circle(Arg::center(get_cell_center(p)), CELL_SIZE * 0.3);
 }
 
+// マウスカーソルがあるセルの座標を返す(盤面の外ならnone)
+Optional<Point> get_cursor_cell(void){
+	const Point p = Cursor::Pos() - Point(BLANK_LEFT, BLANK_TOP);
+	if(p.x < 0 or p.y < 0){
+		return none;
+	}
+	const Point cell(p.x / CELL_SIZE, p.y / CELL_SIZE);
+	if(not is_in_field(cell)){
+		return none;
+	}
+	return cell;
+}
+
 Optional<Point> get_clicked_pos(const Point p, const Array<Point> &dydx){
+	if(not MouseL.down()){
+		return none;
+	}
+	const Optional<Point> cell = get_cursor_cell();
+	if(not cell){
+		return none;
+	}
 	for(const Point q : dydx){
-		if(is_in_field(p + q) and get_grid_rect(p + q).leftClicked()){
+		if(*cell == p + q){
 			return q;
 		}
 	}
 	return none;
 }
 
+// 盤面の描画範囲(左上の余白から右下の枠線まで)
+Size get_board_texture_size(void){
+	return Size(BLANK_LEFT + WIDTH * CELL_SIZE + 1, BLANK_TOP + HEIGHT * CELL_SIZE + 1);
+}
+
 Optional<Point> get_pressed_pos(void){
 	Point direction = { 100, 100 };
 	if(KeyUp.pressed() and KeyLeft.pressed()){
@@ -83,13 +108,11 @@ public:
 	// セルの情報を削除する
 	void delete_bit(const int y, const int x, const CELL delete_bit);
 	void delete_bit(const Point p, const CELL delete_bit);
-	// 盤面のグリッドを表示させる
-	void display_grid(void) const;
-	// 盤面を表示させる
-	void display_actors(void) const;
-	// 陣地計算
+	// 盤面を表示させる(盤面が変わったときだけ描き直す)
+	void display_board(void) const;
+	// 陣地計算(前回から城壁と陣地が変わっていなければ何もしない)
 	void calc_area(void);
-	// ポイント計算
+	// ポイント計算(城壁, 陣地, 城が変わったときだけ数え直す)
 	void calc_point(const TEAM team);
 	// ポイント取得
 	int get_point(const TEAM team);
@@ -101,24 +124,37 @@ public:
 	void update(const MatchStatus &matchstatus);
 
 private:
-	// 陣地計算のためのBFS
-	void wall_bfs(const Point start, Array<Array<bool>> &visited, const TEAM team);
+	// 盤面を空にする
+	void clear_grid(void);
+	// セルの情報の変化を記録する
+	void on_cell_changed(const CELL before, const CELL after);
+	// 変わらない部分(グリッド線, 池, 城)を描く
+	void render_static_layer(void) const;
+	// static_layerに陣地, 城壁, 職人を重ねて描く
+	void render_board_layer(void) const;
 	// 各項目のフィールド更新
 	void update_walls(const Array<Array<int>> &walls);
 	void update_territories(const Array<Array<int>> &territores);
 	void update_structures(const Array<Array<int>> &structures);
 	void update_masons(const Array<Array<int>> &masons);
 
-	// 盤面情報
-	Array<Array<CELL>> grid;
+	// 盤面情報(周囲に番兵を付けた1次元の配列, 添字はRules::to_index)
+	Array<CELL> grid;
+	// 最後に陣地計算をしてから城壁か陣地が変わったか
+	bool is_area_dirty = true;
+	// 最後に数えてから城壁, 陣地, 城が変わったか
+	bool is_count_dirty = true;
+	// 赤, 青の城壁, 陣地, 城の数
+	std::array<Rules::Count, 2> counts;
+	// 描画のキャッシュ
+	mutable MSRenderTexture static_layer;
+	mutable MSRenderTexture board_layer;
+	mutable bool is_static_layer_dirty = true;
+	mutable bool is_board_layer_dirty = true;
 	// 池、城、職人の座標配列
 	Array<Point> ponds;
 	Array<Point> castles;
 	Array<Array<Point>> craftsmen;
-	// それぞれの係数
-	static constexpr int point_castle = 100;
-	static constexpr int point_area = 30;
-	static constexpr int point_wall = 10;
 	// チームポイント
 	int point_red = 0;
 	int point_blue = 0;
@@ -134,9 +170,8 @@ Field::Field(const String &path){
 	const CSV csv(path);
 	HEIGHT = (int)csv.rows();
 	WIDTH = (int)csv.columns(0);
-	this->grid.resize(HEIGHT, Array<CELL>(WIDTH, CELL::NONE));
+	clear_grid();
 	for(int row = 0; row < csv.rows(); row++){
-		this->grid[row].resize(WIDTH);
 		for(int col = 0; col < csv.columns(row); col++){
 			if(csv[row][col] == U"1"){
 				set_bit(row, col, CELL::POND);
@@ -162,9 +197,8 @@ Field::Field(void){
 	const CSV csv(path);
 	HEIGHT = (int)csv.rows();
 	WIDTH = (int)csv.columns(0);
-	this->grid.resize(HEIGHT);
+	clear_grid();
 	for(int row = 0; row < csv.rows(); row++){
-		this->grid[row].resize(WIDTH);
 		for(int col = 0; col < csv.columns(row); col++){
 			if(csv[row][col] == U"1"){
 				set_bit(row, col, CELL::POND);
@@ -187,12 +221,35 @@ Field::Field(void){
 void Field::initialize(const MatchDataMatch &matchdatamatch){
 	HEIGHT = matchdatamatch.board.height;
 	WIDTH = matchdatamatch.board.width;
-	this->grid.clear();
-	this->grid.resize(HEIGHT, Array<CELL>(WIDTH, CELL::NONE));
+	clear_grid();
 	update_structures(matchdatamatch.board.structures);
 	update_masons(matchdatamatch.board.masons);
 }
 
+void Field::clear_grid(void){
+	this->grid.resize(Rules::padded_size);
+	Rules::clear(this->grid.data(), FieldSize());
+	is_area_dirty = true;
+	is_count_dirty = true;
+	is_static_layer_dirty = true;
+	is_board_layer_dirty = true;
+}
+
+void Field::on_cell_changed(const CELL before, const CELL after){
+	const CELL changed = before ^ after;
+	if(changed & (CELL::WALL | CELL::AREA)){
+		is_area_dirty = true;
+	}
+	if(changed & (CELL::WALL | CELL::AREA | CELL::CASTLE)){
+		is_count_dirty = true;
+	}
+	if(changed & (CELL::POND | CELL::CASTLE)){
+		is_static_layer_dirty = true;
+	}
+	if(changed){
+		is_board_layer_dirty = true;
+	}
+}
 
 void Field::update(const MatchStatus &matchstatus){
 	update_walls(matchstatus.board.walls);
@@ -201,17 +258,19 @@ void Field::update(const MatchStatus &matchstatus){
 	update_masons(matchstatus.board.masons);
 }
 
+// 変わったbitだけを書き換える(同じ盤面なら陣地計算をやり直さない)
 void Field::update_walls(const Array<Array<int>> &walls){
 	for(int h = 0; h < HEIGHT; h++){
 		for(int w = 0; w < WIDTH; w++){
 			const int num = walls[h][w];
-			delete_bit(h, w, CELL::WALL);
-			if(num == 0);
-			else if(num == 1){
-				set_bit(h, w, CELL::WALL_RED);
+			CELL wall = CELL::NONE;
+			if(num == 1){
+				wall = CELL::WALL_RED;
 			}else if(num == 2){
-				set_bit(h, w, CELL::WALL_BLUE);
+				wall = CELL::WALL_BLUE;
 			}
+			delete_bit(h, w, CELL::WALL & ~wall);
+			set_bit(h, w, wall);
 		}
 	}
 }
@@ -220,15 +279,16 @@ void Field::update_territories(const Array<Array<int>> &territories){
 	for(int h = 0; h < HEIGHT; h++){
 		for(int w = 0; w < WIDTH; w++){
 			const int num = territories[h][w];
-			delete_bit(h, w, CELL::AREA);
-			if(num == 0);
-			else if(num == 1){
-				set_bit(h, w, CELL::AREA_RED);
+			CELL area = CELL::NONE;
+			if(num == 1){
+				area = CELL::AREA_RED;
 			}else if(num == 2){
-				set_bit(h, w, CELL::AREA_BLUE);
+				area = CELL::AREA_BLUE;
 			}else if(num == 3){
-				set_bit(h, w, CELL::AREA);
+				area = CELL::AREA;
 			}
+			delete_bit(h, w, CELL::AREA & ~area);
+			set_bit(h, w, area);
 		}
 	}
 }
@@ -290,7 +350,7 @@ Array<Point> Field::get_craftsmen(const TEAM team) const {
 
 // セルの情報を取得
 CELL Field::get_cell(const int y, const int x) const {
-	return this->grid[y][x];
+	return this->grid[Rules::to_index(y, x)];
 }
 CELL Field::get_cell(const Point p) const {
 	return this->get_cell(p.y, p.x);
@@ -298,7 +358,9 @@ CELL Field::get_cell(const Point p) const {
 
 // セルの情報を変更
 void Field::set_bit(const int y, const int x, const CELL new_bit){
-	this->grid[y][x] |= new_bit;
+	CELL &cell = this->grid[Rules::to_index(y, x)];
+	on_cell_changed(cell, cell | new_bit);
+	cell |= new_bit;
 }
 void Field::set_bit(const Point p, const CELL new_bit){
 	this->set_bit(p.y, p.x, new_bit);
@@ -306,161 +368,113 @@ void Field::set_bit(const Point p, const CELL new_bit){
 
 // セルの情報を削除
 void Field::delete_bit(const int y, const int x, const CELL delete_bit){
-	this->grid[y][x] &= ~delete_bit;
+	CELL &cell = this->grid[Rules::to_index(y, x)];
+	on_cell_changed(cell, cell & ~delete_bit);
+	cell &= ~delete_bit;
 }
 void Field::delete_bit(const Point p, const CELL delete_bit){
 	this->delete_bit(p.y, p.x, delete_bit);
 }
 
-void Field::display_grid(void) const {
-	for(int i = 0; i < HEIGHT * WIDTH; i++){
-		get_grid_rect(Point(i % WIDTH, i / WIDTH)).drawFrame(1, 1, Palette::Black);
+void Field::display_board(void) const {
+	if(is_static_layer_dirty){
+		render_static_layer();
 	}
-}
-
-void Field::display_actors(void) const {
-	for(int i = 0; i < (HEIGHT * WIDTH); i++){
-		const int y = i / WIDTH;
-		const int x = i % WIDTH;
-		const Point p(x, y);
-		const CELL target_cell = grid[y][x];
-
-		if(target_cell & CELL::POND){
-			get_grid_rect(p).draw(Palette::Black);
-		}
-		if(target_cell & CELL::CASTLE){
-			Shape2D::Star(CELL_SIZE * 0.6, get_cell_center(p)).draw(Palette::Black);
-		}
-		if(target_cell & CELL::AREA_RED and target_cell & CELL::AREA_BLUE){
-			get_grid_rect(p).draw(ColorF(1.0, 0.0, 1.0, 0.5));
-		}else 	if(target_cell & CELL::AREA_RED){
-			get_grid_rect(p).draw(ColorF(1.0, 0.0, 0.0, 0.25));
-		}else 	if(target_cell & CELL::AREA_BLUE){
-			get_grid_rect(p).draw(ColorF(0.0, 0.0, 1.0, 0.25));
-		}
-		if(target_cell & CELL::WALL_RED){
-			Rect(Arg::center(get_cell_center(p)), (int)(CELL_SIZE*0.7)).draw(Palette::Red);
-		}
-		if(target_cell & CELL::WALL_BLUE){
-			Rect(Arg::center(get_cell_center(p)), (int)(CELL_SIZE * 0.7)).draw(Palette::Blue);
-		}
-		if(target_cell & CELL::CRAFTSMAN_RED){
-			Circle(Arg::center(get_cell_center(p)), CELL_SIZE * 0.3).draw(ColorF(1.0, 0.5, 0.5));
-			Circle(Arg::center(get_cell_center(p)), CELL_SIZE * 0.3).drawFrame(1,1,Palette::White);
-		}
-		if(target_cell & CELL::CRAFTSMAN_BLUE){
-			Circle(Arg::center(get_cell_center(p)), CELL_SIZE * 0.3).draw(ColorF(0.5, 0.5, 1.0));
-			Circle(Arg::center(get_cell_center(p)), CELL_SIZE * 0.3).drawFrame(1, 1, Palette::White);
-		}
+	if(is_board_layer_dirty){
+		render_board_layer();
 	}
+	board_layer.draw();
 }
 
-// startからBFSを開始
-const Array<Point> range_area = { {0,-1},{-1,0},{0,1},{1,0} };
-
-void Field::wall_bfs(const Point start, Array<Array<bool>>& visited, const TEAM team){
-	std::queue<Point> que;
-	que.push(start);
-	visited[start.y][start.x] = true;
-	if(get_cell(start) & switch_cell(CELL::WALL, team)){
-		return;
+void Field::render_static_layer(void) const {
+	const Size size = get_board_texture_size();
+	if(static_layer.size() != size){
+		static_layer = MSRenderTexture{ size };
+		board_layer = MSRenderTexture{ size };
 	}
-
-	while(not que.empty()){
-		const Point now = que.front();
-		que.pop();
-		for(const auto &direction : range_area){
-			Point next = now + direction;
-			if(not is_in_field(next)){
-				continue;
+	{
+		const ScopedRenderTarget2D target{ static_layer.clear(Scene::GetBackground()) };
+		for(int i = 0; i < (HEIGHT * WIDTH); i++){
+			const Point p(i % WIDTH, i / WIDTH);
+			const CELL target_cell = get_cell(p);
+			if(target_cell & CELL::POND){
+				get_grid_rect(p).draw(Palette::Black);
 			}
-			if(get_cell(next) & switch_cell(CELL::WALL, team) or
-				visited[next.y][next.x]){
-				continue;
+			if(target_cell & CELL::CASTLE){
+				Shape2D::Star(CELL_SIZE * 0.6, get_cell_center(p)).draw(Palette::Black);
 			}
-			que.push(next);
-			visited[next.y][next.x] = true;
+			get_grid_rect(p).drawFrame(1, 1, Palette::Black);
 		}
 	}
+	Graphics2D::Flush();
+	static_layer.resolve();
+	is_static_layer_dirty = false;
+	is_board_layer_dirty = true;
 }
 
-// 陣地計算
-void Field::calc_area(void){
-	Array<Array<bool>> red_visited(HEIGHT, Array<bool>(WIDTH, false));
-	Array<Array<bool>> blue_visited(HEIGHT, Array<bool>(WIDTH, false));
-	// フィールドの上下左右の辺からBFSを開始
-	for(int h = 0; h < HEIGHT; h++){
-		for(int w = 0; w < WIDTH; w++){
-			if(not (h == 0 or h == HEIGHT - 1 or w == 0 or w == WIDTH - 1)){
-				continue;
+void Field::render_board_layer(void) const {
+	{
+		const ScopedRenderTarget2D target{ board_layer.clear(Scene::GetBackground()) };
+		static_layer.draw();
+		for(int i = 0; i < (HEIGHT * WIDTH); i++){
+			const Point p(i % WIDTH, i / WIDTH);
+			const CELL target_cell = get_cell(p);
+			if(target_cell & CELL::AREA_RED and target_cell & CELL::AREA_BLUE){
+				get_grid_rect(p).draw(ColorF(1.0, 0.0, 1.0, 0.5));
+			}else 	if(target_cell & CELL::AREA_RED){
+				get_grid_rect(p).draw(ColorF(1.0, 0.0, 0.0, 0.25));
+			}else 	if(target_cell & CELL::AREA_BLUE){
+				get_grid_rect(p).draw(ColorF(0.0, 0.0, 1.0, 0.25));
 			}
-			wall_bfs({ h,w }, red_visited, TEAM::RED);
-			wall_bfs({ h, w }, blue_visited, TEAM::BLUE);
-		}
-	}
-
-	// BFSに到達できたかで陣地塗り
-	for(int h = 0; h < HEIGHT; h++){
-		for(int w = 0; w < WIDTH; w++){
-			// 両方の陣地になる場合
-			if((not red_visited[h][w]) and (not blue_visited[h][w])){
-				set_bit(h, w, CELL::AREA);
+			if(target_cell & CELL::WALL_RED){
+				Rect(Arg::center(get_cell_center(p)), (int)(CELL_SIZE*0.7)).draw(Palette::Red);
 			}
-			// 赤の陣地となる場合
-			else if(not red_visited[h][w]){
-				set_bit(h, w, CELL::AREA_RED);
-				delete_bit(h, w, CELL::AREA_BLUE);
+			if(target_cell & CELL::WALL_BLUE){
+				Rect(Arg::center(get_cell_center(p)), (int)(CELL_SIZE * 0.7)).draw(Palette::Blue);
 			}
-			// 青の陣地となる場合
-			else if(not blue_visited[h][w]){
-				set_bit(h, w, CELL::AREA_BLUE);
-				delete_bit(h, w, CELL::AREA_RED);
+			if(target_cell & CELL::CRAFTSMAN_RED){
+				Circle(Arg::center(get_cell_center(p)), CELL_SIZE * 0.3).draw(ColorF(1.0, 0.5, 0.5));
+				Circle(Arg::center(get_cell_center(p)), CELL_SIZE * 0.3).drawFrame(1,1,Palette::White);
 			}
-		}
-	}
-
-	// 壁は陣地外
-	for(int h = 0; h < HEIGHT; h++){
-		for(int w = 0; w < WIDTH; w++){
-			if(get_cell(h, w) & CELL::WALL_RED){
-				delete_bit(h, w, CELL::AREA_RED);
-			}
-			if(get_cell(h, w) & CELL::WALL_BLUE){
-				delete_bit(h, w, CELL::AREA_BLUE);
+			if(target_cell & CELL::CRAFTSMAN_BLUE){
+				Circle(Arg::center(get_cell_center(p)), CELL_SIZE * 0.3).draw(ColorF(0.5, 0.5, 1.0));
+				Circle(Arg::center(get_cell_center(p)), CELL_SIZE * 0.3).drawFrame(1, 1, Palette::White);
 			}
 		}
 	}
+	Graphics2D::Flush();
+	board_layer.resolve();
+	is_board_layer_dirty = false;
+}
 
+// 陣地計算(solverと同じRules::update_territory)
+// 城壁と陣地が同じなら結果も同じなので、変わっていなければ計算しない
+void Field::calc_area(void){
+	if(not is_area_dirty){
+		return;
+	}
+	// gridに直接書くのでon_cell_changedを通らない. 陣地が変わりうるので描画もやり直す
+	Rules::update_territory(this->grid.data(), FieldSize());
+	is_area_dirty = false;
+	is_count_dirty = true;
+	is_board_layer_dirty = true;
 }
 
 
 void Field::calc_point(const TEAM team){
-	int point = 0;
-	Array<int> building = { 0,0,0 };
-	for(int h = 0; h < HEIGHT; h++){
-		for(int w = 0; w < WIDTH; w++){
-			if(get_cell(h, w) & switch_cell(CELL::AREA, team)){
-				if(get_cell(h, w) & CELL::CASTLE){
-					point += this->point_castle;
-					building[2]++;
-				}
-				point += this->point_area;
-				building[1]++;
-			}else if(get_cell(h, w) & switch_cell(CELL::WALL, team)){
-				point += this->point_wall;
-				building[0]++;
-			}
-		}
+	if(is_count_dirty){
+		counts = Rules::count(this->grid.data(), FieldSize());
+		is_count_dirty = false;
 	}
+	const Rules::Count count = counts[team];
+	const Array<int> building = { count.walls, count.areas, count.castles };
 	if(team == TEAM::RED){
-		point_red = point;
+		point_red = count.points();
 		building_red = building;
 	}else if(team == TEAM::BLUE){
-		point_blue = point;
+		point_blue = count.points();
 		building_blue = building;
 	}
-
-
 }
 
 int Field::get_point(const TEAM team){
@@ -483,7 +497,7 @@ void Field::output_field(void){
 	for(int h = 0; h < HEIGHT; h++){
 		String str = U"";
 		for(int w = 0; w < WIDTH; w++){
-			str += U"{:3X} "_fmt((unsigned char)grid[h][w]);
+			str += U"{:3X} "_fmt((unsigned char)get_cell(h, w));
 		}
 		Console << str;
 	}
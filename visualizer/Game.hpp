@@ -4,12 +4,27 @@
 # include "Field.hpp"
 # include "Actor.hpp"
 # include "Connect.hpp"
+# include "SolverIO.hpp"
+# ifdef SOLVER_LIBRARY
+# include "SolverLibrary.hpp"
+# endif
 
 
 using App = SceneManager<String, Field>;
 
 const Array<Input> keyboard_craftsman = { Key0, Key1, Key2, Key3, Key4, Key5, Key6, Key7, Key8 };
 
+// solverの動かし方
+// SOLVER_LIBRARYを定義するとsolver.exeを起動せずに同じプロセスで動かす(SolverLibrary.hpp)
+// (solver_lib.cppはまだMSVCでビルドを確かめていないので試験的. 通常はsolver.exeを使う)
+std::unique_ptr<SolverBackend> make_solver_backend(void){
+# ifdef SOLVER_LIBRARY
+	return std::make_unique<SolverLibrary>();
+# else
+	return std::make_unique<SolverProcess>(U"solver.exe");
+# endif
+}
+
 
 class Game {
 protected:
@@ -25,21 +40,31 @@ protected:
 	void give_solver_initialize(const bool is_first, Field &field);
 	// solverに職人の行動を渡す(引数にはsolverのチーム)
 	void give_solver(const TEAM team);
-	// solverから行動を受け取る(引数にはsolverのチーム)
-	void receive_solver(const TEAM team, Field &field);
+	// solverの最終的な行動が届いていれば職人を動かしてtrueを返す(引数にはsolverのチーム, 暫定の行動は読み飛ばす)
+	bool receive_solver(const TEAM team, Field &field);
+	// solverから届いた行動で職人を動かす
+	void apply_solver_acts(const TEAM team, const Array<Craftsman> &acts, Field &field);
 	// GUIで建築予定の場所を受け取る
 	void receive_build_plan(Field &field);
 	void give_solver_build_plan(void);
+	// サーバーの盤面をsolverに渡す(前回から変わったマスと職人の位置)
+	void give_solver_snapshot(const TEAM team, const MatchStatusBoard &board);
+	// solverの探索の様子が届いていれば受け取る
+	void receive_solver_insight(void);
+	// solverの探索の様子を盤面に重ねて表示する(引数にはsolverのチーム)
+	void display_solver_insight(const TEAM team) const;
 	// 職人の配列
 	Array<Array<Craftsman>> craftsmen;
 	// solverプログラム
-	ChildProcess child{ U"solver.exe", Pipe::StdInOut };
+	std::unique_ptr<SolverBackend> solver = make_solver_backend();
 	// 現在のターン、ポイント数のフォント
 	const Font normal_font = Font(50, U"SourceHanSansJP-Medium.otf");
 	// 建築物の数のフォント
 	const Font small_font = Font(25, U"SourceHanSansJP-Medium.otf");
 	// 職人の番号のフォント
 	const Font craftsman_font = Font((int32)CELL_SIZE,  U"SourceHanSansJP-Medium.otf");
+	// solverの探索の様子のフォント
+	const Font insight_font = Font(12, U"SourceHanSansJP-Medium.otf");
 	// 試合のターン数
 	int turn_num = 200;
 	// 現在のターン数
@@ -50,6 +75,12 @@ protected:
 	int time = 3000;
 	// 建築予定
 	Array<Array<bool>> is_build_plan;
+	// 最後にsolverに渡した盤面(城壁*4 + 陣地)
+	Array<Array<int>> solver_snapshot;
+	// 最後に届いたsolverの探索の様子
+	Optional<SolverInsight> solver_insight;
+	// これまでに届いた探索の様子(グラフ用に数値だけを残す)
+	Array<SolverInsight> insight_history;
 };
 
 void Game::operate_gui(Field &field){
@@ -162,92 +193,164 @@ void Game::display_details(Field &field) const {
 }
 
 void Game::give_solver_initialize(const bool is_first, Field &field){
-	// フィールドの縦横
-	child.ostream() << HEIGHT << std::endl << WIDTH << std::endl;
-	// solver.exeを赤色とする
-	child.ostream() << ((is_first) ? 0 : 1) << std::endl;
-	// ターン数
-	child.ostream() << turn_num << std::endl;
-	// 持ち時間
-	child.ostream() << time << std::endl;
-	// 池の数と座標
-	child.ostream() << field.get_ponds().size() << std::endl;
-	for (const Point p : field.get_ponds()) {
-		child.ostream() << p.y << std::endl << p.x << std::endl;
-	}
-	// 城の数と座標
-	child.ostream() << field.get_castles().size() << std::endl;
-	for (const Point p : field.get_castles()) {
-		child.ostream() << p.y << std::endl << p.x << std::endl;
-	}
-	// REDのチームの職人
-	child.ostream() << field.get_craftsmen(TEAM::RED).size() << std::endl;
-	for(const Point p : field.get_craftsmen(TEAM::RED)){
-		child.ostream() << p.y << std::endl << p.x << std::endl;
-	}
-	// BLUEチームの職人
-	child.ostream() << field.get_craftsmen(TEAM::BLUE).size() << std::endl;
-	for(const Point p : field.get_craftsmen(TEAM::BLUE)){
-		child.ostream() << p.y << std::endl << p.x << std::endl;
-	}
+	solver_snapshot.assign(HEIGHT, Array<int>(WIDTH, 0));
+	solver->initialize(is_first, turn_num, time, field);
 }
 
 void Game::give_solver(const TEAM team){
-	for(const Craftsman &craftsman : craftsmen[not team]){
-		craftsman.output_act(child);
+	solver->give_acts(craftsmen[not team]);
+}
+
+bool Game::receive_solver(const TEAM team, Field &field){
+	while(Optional<SolverMessage> message = solver->pop()){
+		if(message->is_final){
+			apply_solver_acts(team, message->acts, field);
+			return true;
+		}
 	}
+	return false;
 }
 
-void Game::receive_solver(const TEAM team, Field &field){
-	for(Craftsman& craftsman : craftsmen[team]){
-		craftsman.input_act(child, field);
+void Game::apply_solver_acts(const TEAM team, const Array<Craftsman> &acts, Field &field){
+	for(size_t i = 0; i < acts.size(); i++){
+		Craftsman &craftsman = craftsmen[team][i];
+		craftsman.direction = acts[i].direction;
+		craftsman.act = acts[i].act;
+		craftsman.apply_act(field);
 	}
 }
 
 void Game::receive_build_plan(Field &field){
+	if(not (MouseR.down() or MouseL.down() or KeyLControl.down())){
+		return;
+	}
+	const Optional<Point> cell = get_cursor_cell();
+	if(not cell){
+		return;
+	}
+	const int h = cell->y;
+	const int w = cell->x;
+	if(field.get_cell(h, w) & CELL::CASTLE){
+		return;
+	}
+	bool is_around_wall = true;
+	for(auto& dydx : range_wall){
+		if(not is_in_field(h + dydx.y, w + dydx.x)){
+			continue;
+		}
+		if(not (field.get_cell(h + dydx.y, w + dydx.x) & CELL::POND)){
+			is_around_wall = false;
+			break;
+		}
+	}
+	if(is_around_wall){
+		return;
+	}
+	is_build_plan[h][w] ^= true;
+}
+
+void Game::give_solver_build_plan(void){
+	Array<Point> walls;
 	for(int h = 0; h < HEIGHT; h++){
 		for(int w = 0; w < WIDTH; w++){
-			if(get_grid_rect({ w, h }).rightClicked()
-				or get_grid_rect({w,h}).leftClicked()
-				or (get_grid_rect({w,h}).mouseOver() and KeyLControl.down() )) {
-				if(field.get_cell(h, w) & CELL::CASTLE){
-					continue;
-				}
-				bool is_around_wall = true;
-				for(auto& dydx : range_wall){
-					if(not is_in_field(h + dydx.y, w + dydx.x)){
-						continue;
-					}
-					if(not (field.get_cell(h + dydx.y, w + dydx.x) & CELL::POND)){
-						is_around_wall = false;
-						break;
-					}
-				}
-				if(is_around_wall){
-					continue;
-				}
-				is_build_plan[h][w] ^= true;
+			if(is_build_plan[h][w]){
+				walls << Point(w, h);
 			}
 		}
 	}
+	solver->give_build_plan(walls);
 }
 
-void Game::give_solver_build_plan(void){
-	int n = 0;
-	for(const auto &ary : is_build_plan){
-		for(const auto &cell : ary){
-			if(cell){
-				n++;
+void Game::give_solver_snapshot(const TEAM team, const MatchStatusBoard &board){
+	// solverから見た 城壁(0:なし 1:味方 2:敵)*4 + 陣地(bit0:味方 bit1:敵)
+	Array<Point> changed;
+	for(int h = 0; h < HEIGHT; h++){
+		for(int w = 0; w < WIDTH; w++){
+			int wall = board.walls[h][w];
+			int territory = board.territories[h][w];
+			if(team == TEAM::BLUE){
+				wall = (wall == 0) ? 0 : 3 - wall;
+				territory = ((territory & 1) << 1) | (territory >> 1);
+			}
+			const int code = wall * 4 + territory;
+			if(code != solver_snapshot[h][w]){
+				solver_snapshot[h][w] = code;
+				changed << Point(w, h);
 			}
 		}
 	}
-	child.ostream() << n << std::endl;
+	Array<Point> ally(craftsmen[team].size()), enemy(craftsmen[not team].size());
 	for(int h = 0; h < HEIGHT; h++){
 		for(int w = 0; w < WIDTH; w++){
-			if(is_build_plan[h][w]){
-				child.ostream() << h << std::endl;
-				child.ostream() << w << std::endl;
+			const int num = board.masons[h][w];
+			if(num == 0){
+				continue;
 			}
+			const TEAM mason_team = (num > 0) ? TEAM::RED : TEAM::BLUE;
+			((mason_team == team) ? ally : enemy)[Abs(num) - 1] = Point(w, h);
+		}
+	}
+	solver->give_snapshot(solver_snapshot, changed, ally, enemy);
+}
+
+void Game::receive_solver_insight(void){
+	Optional<SolverInsight> insight = solver->pop_insight();
+	if(not insight){
+		return;
+	}
+	SolverInsight record = *insight;
+	record.routes.clear();
+	record.territory.clear();
+	insight_history << record;
+	solver_insight = std::move(insight);
+}
+
+void Game::display_solver_insight(const TEAM team) const {
+	if(not solver_insight){
+		return;
+	}
+	const SolverInsight &insight = *solver_insight;
+	// 予定の壁を全て建てたときの陣地
+	for(const Point p : insight.territory){
+		Circle(get_cell_center(p), CELL_SIZE * 0.12).draw(ColorF(0.6, 0.0, 0.0, 0.6));
+	}
+	// 職人ごとの壁の順番(職人の位置から順に結ぶ)
+	const size_t routes_num = Min(insight.routes.size(), craftsmen[team].size());
+	for(size_t i = 0; i < routes_num; i++){
+		const ColorF color = HSV(360.0 * i / routes_num, 0.8, 0.8).toColorF();
+		LineString route;
+		route << get_cell_center(craftsmen[team][i].pos);
+		for(const Point p : insight.routes[i]){
+			route << get_cell_center(p);
+		}
+		route.draw(2, color.withAlpha(0.6));
+		for(size_t k = 0; k < insight.routes[i].size(); k++){
+			insight_font(k + 1).drawAt(get_cell_center(insight.routes[i][k]), color);
 		}
 	}
+
+	// 数値と直近のターンのグラフ(使った時間の期限に対する割合, SAのステップ数)
+	insight_font(U"turn {}  SA {} steps  cost {}  score {}  {}/{} ms"_fmt(insight.turn, insight.sa_steps, insight.best_cost, insight.score, insight.elapsed_ms, insight.limit_ms)).draw(800, 625, Palette::Black);
+	constexpr size_t graph_turns = 50;
+	const Rect time_graph{ 800, 645, 200, 60 };
+	const Rect steps_graph{ 1030, 645, 200, 60 };
+	const size_t shown = Min(insight_history.size(), graph_turns);
+	const size_t first = insight_history.size() - shown;
+	const double bar_width = (double)time_graph.w / graph_turns;
+	int max_steps = 1;
+	for(size_t i = first; i < insight_history.size(); i++){
+		max_steps = Max(max_steps, insight_history[i].sa_steps);
+	}
+	LineString steps_line;
+	for(size_t i = 0; i < shown; i++){
+		const SolverInsight &record = insight_history[first + i];
+		const double ratio = Min(1.0, (double)record.elapsed_ms / Max(1, record.limit_ms));
+		RectF(time_graph.x + i * bar_width, time_graph.bottomY() - ratio * time_graph.h, bar_width - 1, ratio * time_graph.h).draw((ratio > 0.9) ? Palette::Red : Palette::Gray);
+		steps_line << Vec2(steps_graph.x + (i + 0.5) * bar_width, steps_graph.bottomY() - (double)record.sa_steps / max_steps * steps_graph.h);
+	}
+	steps_line.draw(2, Palette::Darkblue);
+	time_graph.drawFrame(1, 0, Palette::Black);
+	steps_graph.drawFrame(1, 0, Palette::Black);
+	insight_font(U"時間/期限").draw(time_graph.pos.movedBy(2, 0), Palette::Black);
+	insight_font(U"SAステップ数(最大{})"_fmt(max_steps)).draw(steps_graph.pos.movedBy(2, 0), Palette::Black);
 }
@@ -0,0 +1,118 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include <chrono>
+# include <mutex>
+# include <thread>
+# include <condition_variable>
+# include "Connect.hpp"
+# include "SpscQueue.hpp"
+
+
+// 試合状況を別スレッドで取得し、ターンが進んだときだけゲームループに渡す
+// 次のターンの切り替わり(前回の切り替わり + 持ち時間)の手前までは取得せず、その前後だけ短い間隔で取得する
+class MatchStatusPoller {
+public:
+	MatchStatusPoller(Connect &connect, const int turn_ms);
+	~MatchStatusPoller();
+	// ターンが進んだ試合状況を古い順に取り出す(なければnone)
+	Optional<MatchStatus> pop(void);
+
+private:
+	using Clock = std::chrono::steady_clock;
+	// 切り替わりの予定時刻のこれだけ前から短い間隔で取得する
+	static constexpr int BURST_BEFORE_MS = 200;
+	// 切り替わりの前後の取得間隔
+	static constexpr int BURST_INTERVAL_MS = 20;
+	// 切り替わりの時刻がわからないときの取得間隔
+	static constexpr int IDLE_INTERVAL_MS = 100;
+	// 予定が大きくずれても気付けるように、待つのは最大でもこれだけ
+	static constexpr int MAX_WAIT_MS = 500;
+
+	void run(void);
+	// 次に取得するまでの時間
+	int next_wait_ms(const Clock::time_point now);
+
+	Connect &connect;
+	const int turn_ms;
+	SpscQueue<MatchStatus, 8> queue;
+	// 推定したターンの切り替わりの時刻
+	Optional<Clock::time_point> boundary;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopped = false;
+	std::thread thread;
+};
+
+MatchStatusPoller::MatchStatusPoller(Connect &connect, const int turn_ms) : connect(connect), turn_ms(turn_ms){
+	thread = std::thread([this]{ run(); });
+}
+
+MatchStatusPoller::~MatchStatusPoller(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = true;
+	}
+	cv.notify_one();
+	thread.join();
+}
+
+Optional<MatchStatus> MatchStatusPoller::pop(void){
+	return queue.pop();
+}
+
+int MatchStatusPoller::next_wait_ms(const Clock::time_point now){
+	if(not boundary){
+		return IDLE_INTERVAL_MS;
+	}
+	const int since_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(now - *boundary).count();
+	const int until_ms = turn_ms - since_ms;
+	if(until_ms > BURST_BEFORE_MS){
+		return Min(until_ms - BURST_BEFORE_MS, MAX_WAIT_MS);
+	}
+	// 予定を半ターン過ぎても進まなければ、推定をやめて通常の間隔に戻す
+	if(until_ms < -turn_ms / 2){
+		boundary = none;
+		return IDLE_INTERVAL_MS;
+	}
+	return BURST_INTERVAL_MS;
+}
+
+void MatchStatusPoller::run(void){
+	// 最後にゲームループに渡したターン
+	int last_turn = -1;
+	// 最後に取得したターン(切り替わりの推定に使う)
+	int seen_turn = -1;
+	// キューが一杯で渡せなかったことを最後に出力したターン
+	int full_turn = -1;
+	Optional<Clock::time_point> last_poll;
+	while(true){
+		const Clock::time_point poll_time = Clock::now();
+		// logsは前回渡したターンより後のものだけ読む
+		if(Optional<MatchStatus> status = connect.get_match_status(Max(last_turn, 0))){
+			if(status->turn != seen_turn){
+				// 切り替わりは前回の取得と今回の取得の間にある
+				if(seen_turn >= 0 and last_poll){
+					boundary = *last_poll + (poll_time - *last_poll) / 2;
+				}
+				seen_turn = status->turn;
+			}
+			if(status->turn != last_turn){
+				// キューが一杯なら渡したことにせず、次の取得で(その間のlogsも含めて)渡し直す
+				const int turn = status->turn;
+				if(queue.push(std::move(*status))){
+					last_turn = turn;
+				}
+				else if(full_turn != turn){
+					Console << U"MatchStatusPoller: queue is full, turn {} will be retried"_fmt(turn);
+					full_turn = turn;
+				}
+			}
+		}
+		last_poll = poll_time;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		if(cv.wait_for(lock, std::chrono::milliseconds(next_wait_ms(Clock::now())), [this]{ return stopped; })){
+			return;
+		}
+	}
+}
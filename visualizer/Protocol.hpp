@@ -0,0 +1,77 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include <limits>
+
+// solverとの通信形式 (solver/protocol.hppと同じ形式)
+// BINARYのときはsolver起動直後に"binary"を送り、以降は1フレーム = 種類(1文字) + 固定長の数値列 + '\n' でやり取りする
+// 数値は6bitずつ '0'+v の1文字にして上位から並べる
+//   I: 初期化   h w side turns(2) time(3) 池 城 赤の職人 青の職人 (それぞれ 個数(2) + y x の列)
+//   A: 行動     職人数 + 職人ごとに direction*4+ACT
+//   P: 建築予定 個数(2) + y x の列
+//   S: 盤面の同期 前回から変わったマスの個数(2) + y x code の列, 味方の職人, 敵の職人 (codeは城壁*4 + 陣地)
+//   Q: 暫定の行動 Aと同じ形式. solverは自分のターンに暫定の行動Qを0個以上送ってから、最終的な行動Aを1つ送る
+//   N: 探索の様子 turn(2) 使った時間(3) 期限(3) SAのステップ数(4) 最大移動コスト(2) score+PROTOCOL_SCORE_OFFSET(3)
+//      職人数 + 職人ごとの壁の順番, 予定の壁を全て建てたときの陣地 (座標の列はIと同じ形式). Aの後に届く
+// TEXTのときQは"plan"の後に行動を並べ、Nは"insight"の後に同じ順で数値を並べる
+enum class PROTOCOL {
+	TEXT,
+	BINARY
+};
+constexpr PROTOCOL SOLVER_PROTOCOL = PROTOCOL::BINARY;
+
+constexpr int PROTOCOL_DIGIT_BITS = 6;
+constexpr int PROTOCOL_DIGIT_MASK = (1 << PROTOCOL_DIGIT_BITS) - 1;
+constexpr int PROTOCOL_SCORE_OFFSET = 1 << 17;
+
+// 数値をn文字で書き込む
+void write_digits(std::ostream &os, const int v, const int n){
+	for(int i = n - 1; i >= 0; i--){
+		os.put((char)('0' + ((v >> (PROTOCOL_DIGIT_BITS * i)) & PROTOCOL_DIGIT_MASK)));
+	}
+}
+
+// n文字の数値を読み込む
+int read_digits(std::istream &is, const int n){
+	int v = 0;
+	for(int i = 0; i < n; i++){
+		v = (v << PROTOCOL_DIGIT_BITS) | ((is.get() - '0') & PROTOCOL_DIGIT_MASK);
+	}
+	return v;
+}
+
+// 座標の列を個数(2文字) + y x の列で書き込む
+void write_points(std::ostream &os, const Array<Point> &points){
+	write_digits(os, (int)points.size(), 2);
+	for(const Point p : points){
+		write_digits(os, p.y, 1);
+		write_digits(os, p.x, 1);
+	}
+}
+
+// 個数(2文字) + y x の列を読み込む
+Array<Point> read_points(std::istream &is){
+	Array<Point> points(read_digits(is, 2));
+	for(Point &p : points){
+		p.y = read_digits(is, 1);
+		p.x = read_digits(is, 1);
+	}
+	return points;
+}
+
+// フレームの先頭(種類)を読み込む
+char read_frame_type(std::istream &is){
+	is >> std::ws;
+	return (char)is.get();
+}
+bool read_frame_type(std::istream &is, const char type){
+	return read_frame_type(is) == type;
+}
+// フレームの残りを'\n'まで読み飛ばす(壊れたフレームの後で次のフレームの先頭に戻る)
+void skip_frame(std::istream &is){
+	is.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+}
+
+// フレームの終わり
+void end_frame(std::ostream &os){
+	os << '\n' << std::flush;
+}
@@ -13,6 +13,10 @@ public:
 	void draw() const override;
 private:
 	TEAM team_solver = TEAM::RED;
+	// solverの行動を待っているか(待っている間も描画は続ける)
+	bool is_waiting_solver = false;
+	// solverの行動が届いていれば反映して人のターンにする
+	void wait_solver(Field &field);
 };
 
 PvC::PvC(const InitData &init) : IScene(init){
@@ -31,18 +35,25 @@ PvC::PvC(const InitData &init) : IScene(init){
 
 	// Computerが先手の場合
 	if(team_solver == TEAM::RED){
-		System::Sleep(1.5s);
-		now_turn = (not now_turn);
-		receive_solver(team_solver, getData());
-		for(Array<Craftsman>& ary : craftsmen){
-			for(Craftsman& craftsman : ary){
-				craftsman.initialize();
-			}
+		now_turn = team_solver;
+		is_waiting_solver = true;
+	}
+}
+
+void PvC::wait_solver(Field &field){
+	if(not receive_solver(team_solver, field)){
+		return;
+	}
+	is_waiting_solver = false;
+	for(Array<Craftsman>& ary : craftsmen){
+		for(Craftsman& craftsman : ary){
+			craftsman.initialize();
 		}
-		getData().calc_area();
-		getData().calc_point(TEAM::RED);
-		getData().calc_point(TEAM::BLUE);
 	}
+	now_turn = not team_solver;
+	field.calc_area();
+	field.calc_point(TEAM::RED);
+	field.calc_point(TEAM::BLUE);
 }
 
 void PvC::operate_gui(Field &field){
@@ -52,19 +63,9 @@ void PvC::operate_gui(Field &field){
 		field.calc_point(TEAM::RED);
 		field.calc_point(TEAM::BLUE);
 		give_solver(team_solver);
-		//give_solver_build_plan();
-		System::Sleep(1.5s);
-		now_turn = not now_turn;
-		receive_solver(team_solver, field);
-		for(Array<Craftsman>& ary : craftsmen){
-			for(Craftsman& craftsman : ary){
-				craftsman.initialize();
-			}
-		}
-		now_turn = not now_turn;
-		field.calc_area();
-		field.calc_point(TEAM::RED);
-		field.calc_point(TEAM::BLUE);
+		give_solver_build_plan();
+		now_turn = team_solver;
+		is_waiting_solver = true;
 	}
 }
 
@@ -90,14 +91,17 @@ void PvC::display_field(void) const {
 }
 
 void PvC::update(){
-	operate_gui(getData());
-	operate_craftsman(now_turn, getData());
+	if(is_waiting_solver){
+		wait_solver(getData());
+	}else{
+		operate_gui(getData());
+		operate_craftsman(now_turn, getData());
+	}
 	receive_build_plan(getData());
 }
 
 void PvC::draw() const {
-	getData().display_grid();
-	getData().display_actors();
+	getData().display_board();
 	display_field();
 	display_details(getData());
 }
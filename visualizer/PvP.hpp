@@ -31,7 +31,6 @@ void PvP::update(){
 }
 
 void PvP::draw() const {
-	getData().display_grid();
-	getData().display_actors();
+	getData().display_board();
 	display_details(getData());
 }
@@ -0,0 +1,360 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include <deque>
+# include <mutex>
+# include <atomic>
+# include <cctype>
+# include <chrono>
+# include <thread>
+# include <sstream>
+# include <condition_variable>
+# include "Actor.hpp"
+# include "Protocol.hpp"
+# include "SpscQueue.hpp"
+
+
+// solverから届いた行動(職人ごとのdirectionとactだけを使う)
+struct SolverMessage {
+	// 最終的な行動か(falseなら探索途中の暫定の行動)
+	bool is_final = true;
+	Array<Craftsman> acts;
+};
+
+
+// solverの自分のターンの探索の様子(Protocol.hppのN)
+struct SolverInsight {
+	int turn = 0;
+	// 使った時間と出力の期限(ms)
+	int elapsed_ms = 0;
+	int limit_ms = 0;
+	// 焼きなましのステップ数と最良の最大移動コスト
+	int sa_steps = 0;
+	int best_cost = 0;
+	// 行動後の評価(solver - 相手)
+	int score = 0;
+	// 職人ごとの建てる予定の壁の順番
+	Array<Array<Point>> routes;
+	// routesの壁を全て建てたときのsolverの陣地
+	Array<Point> territory;
+};
+
+
+// solverとのやり取り(solverは赤). どのメソッドもsolverの処理を待たずに返る
+// 1ターン分の入力は [give_snapshot] give_acts give_build_plan の順に渡し、solverの行動はpop()で取り出す
+class SolverBackend {
+public:
+	virtual ~SolverBackend(){}
+	// 試合の情報を渡す
+	virtual void initialize(const bool is_first, const int turn_num, const int time_ms, const Field &field) = 0;
+	// サーバーの盤面を渡す(codes[h][w]は城壁*4 + 陣地, changedは前回渡したときから変わったマス)
+	virtual void give_snapshot(const Array<Array<int>> &codes, const Array<Point> &changed, const Array<Point> &ally, const Array<Point> &enemy) = 0;
+	// 相手の職人の行動を渡す
+	virtual void give_acts(const Array<Craftsman> &acts) = 0;
+	// 建築予定を渡す
+	virtual void give_build_plan(const Array<Point> &walls) = 0;
+	// 届いた行動を古い順に取り出す(なければnone)
+	Optional<SolverMessage> pop(void){ return receive_queue.pop(); }
+	// 最後に届いた探索の様子を取り出す(前回から届いていなければnone)
+	Optional<SolverInsight> pop_insight(void){
+		std::lock_guard<std::mutex> lock(insight_mutex);
+		Optional<SolverInsight> insight = std::move(latest_insight);
+		latest_insight.reset();
+		return insight;
+	}
+
+protected:
+	// 届いた行動を渡す. 満杯なら取り出されるまで待ち(最終的な行動を落とさない)、receive_stoppedならfalse
+	bool push(SolverMessage &&message){
+		while(not receive_queue.push(std::move(message))){
+			if(receive_stopped){
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+	std::atomic<bool> receive_stopped{ false };
+	// 届いた探索の様子を渡す(行動とは別に最新のものだけを残す)
+	void push_insight(SolverInsight &&insight){
+		std::lock_guard<std::mutex> lock(insight_mutex);
+		latest_insight = std::move(insight);
+	}
+
+private:
+	SpscQueue<SolverMessage, 64> receive_queue;
+	std::mutex insight_mutex;
+	Optional<SolverInsight> latest_insight;
+};
+
+
+// solver.exeを子プロセスとして起動し、標準入出力でやり取りする(形式はProtocol.hpp)
+// 読み書きはそれぞれ別スレッドで行い、メインスレッドはパイプを待たない
+class SolverProcess : public SolverBackend {
+public:
+	explicit SolverProcess(const FilePath &path);
+	~SolverProcess() override;
+	void initialize(const bool is_first, const int turn_num, const int time_ms, const Field &field) override;
+	void give_snapshot(const Array<Array<int>> &codes, const Array<Point> &changed, const Array<Point> &ally, const Array<Point> &enemy) override;
+	void give_acts(const Array<Craftsman> &acts) override;
+	void give_build_plan(const Array<Point> &walls) override;
+
+private:
+	// bufferに書いたデータを送信スレッドに渡す
+	void send(void);
+	void run_writer(void);
+	void run_reader(const int craftsman_num);
+	// 1つ分の行動を読む(途中の探索の様子はpush_insightに渡す). solverが終了していればnone
+	Optional<SolverMessage> read_message(std::istream &is, const int craftsman_num);
+	// 探索の様子を読む(種類の後から)
+	SolverInsight read_insight(std::istream &is);
+
+	ChildProcess child;
+	std::ostringstream buffer;
+	std::deque<std::string> send_queue;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopped = false;
+	std::thread writer;
+	std::thread reader;
+};
+
+SolverProcess::SolverProcess(const FilePath &path) : child(path, Pipe::StdInOut){
+	writer = std::thread([this]{ run_writer(); });
+}
+
+SolverProcess::~SolverProcess(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = true;
+	}
+	cv.notify_one();
+	// 書き込み中・読み込み中のスレッドはsolverを終了させてパイプを閉じると抜ける
+	// (パイプが詰まって書き込みが止まっていることがあるので、joinより先に終了させる)
+	receive_stopped = true;
+	child.terminate();
+	writer.join();
+	if(reader.joinable()){
+		reader.join();
+	}
+}
+
+void SolverProcess::initialize(const bool is_first, const int turn_num, const int time_ms, const Field &field){
+	// solver.exeは赤の職人の行動を返す
+	if(not reader.joinable()){
+		const int craftsman_num = (int)field.get_craftsmen(TEAM::RED).size();
+		reader = std::thread([this, craftsman_num]{ run_reader(craftsman_num); });
+	}
+	if(SOLVER_PROTOCOL == PROTOCOL::BINARY){
+		buffer << "binary" << '\n' << 'I';
+		write_digits(buffer, HEIGHT, 1);
+		write_digits(buffer, WIDTH, 1);
+		write_digits(buffer, (is_first) ? 0 : 1, 1);
+		write_digits(buffer, turn_num, 2);
+		write_digits(buffer, time_ms, 3);
+		write_points(buffer, field.get_ponds());
+		write_points(buffer, field.get_castles());
+		write_points(buffer, field.get_craftsmen(TEAM::RED));
+		write_points(buffer, field.get_craftsmen(TEAM::BLUE));
+		end_frame(buffer);
+		send();
+		return;
+	}
+	// フィールドの縦横
+	buffer << HEIGHT << std::endl << WIDTH << std::endl;
+	// solver.exeを赤色とする
+	buffer << ((is_first) ? 0 : 1) << std::endl;
+	// ターン数
+	buffer << turn_num << std::endl;
+	// 持ち時間
+	buffer << time_ms << std::endl;
+	// 池の数と座標
+	buffer << field.get_ponds().size() << std::endl;
+	for (const Point p : field.get_ponds()) {
+		buffer << p.y << std::endl << p.x << std::endl;
+	}
+	// 城の数と座標
+	buffer << field.get_castles().size() << std::endl;
+	for (const Point p : field.get_castles()) {
+		buffer << p.y << std::endl << p.x << std::endl;
+	}
+	// REDのチームの職人
+	buffer << field.get_craftsmen(TEAM::RED).size() << std::endl;
+	for(const Point p : field.get_craftsmen(TEAM::RED)){
+		buffer << p.y << std::endl << p.x << std::endl;
+	}
+	// BLUEチームの職人
+	buffer << field.get_craftsmen(TEAM::BLUE).size() << std::endl;
+	for(const Point p : field.get_craftsmen(TEAM::BLUE)){
+		buffer << p.y << std::endl << p.x << std::endl;
+	}
+	send();
+}
+
+void SolverProcess::give_snapshot(const Array<Array<int>> &codes, const Array<Point> &changed, const Array<Point> &ally, const Array<Point> &enemy){
+	if(SOLVER_PROTOCOL == PROTOCOL::BINARY){
+		buffer << 'S';
+		write_digits(buffer, (int)changed.size(), 2);
+		for(const Point p : changed){
+			write_digits(buffer, p.y, 1);
+			write_digits(buffer, p.x, 1);
+			write_digits(buffer, codes[p.y][p.x], 1);
+		}
+		write_points(buffer, ally);
+		write_points(buffer, enemy);
+		end_frame(buffer);
+		send();
+		return;
+	}
+	buffer << "snapshot" << std::endl << changed.size() << std::endl;
+	for(const Point p : changed){
+		buffer << p.y << std::endl << p.x << std::endl << codes[p.y][p.x] << std::endl;
+	}
+	for(const Array<Point> &points : { ally, enemy }){
+		buffer << points.size() << std::endl;
+		for(const Point p : points){
+			buffer << p.y << std::endl << p.x << std::endl;
+		}
+	}
+	send();
+}
+
+void SolverProcess::give_acts(const Array<Craftsman> &acts){
+	if(SOLVER_PROTOCOL == PROTOCOL::BINARY){
+		buffer << 'A';
+		write_digits(buffer, (int)acts.size(), 1);
+	}
+	for(const Craftsman &craftsman : acts){
+		craftsman.output_act(buffer);
+	}
+	if(SOLVER_PROTOCOL == PROTOCOL::BINARY){
+		end_frame(buffer);
+	}
+	send();
+}
+
+void SolverProcess::give_build_plan(const Array<Point> &walls){
+	if(SOLVER_PROTOCOL == PROTOCOL::BINARY){
+		buffer << 'P';
+		write_points(buffer, walls);
+		end_frame(buffer);
+		send();
+		return;
+	}
+	buffer << walls.size() << std::endl;
+	for(const Point p : walls){
+		buffer << p.y << std::endl;
+		buffer << p.x << std::endl;
+	}
+	send();
+}
+
+void SolverProcess::send(void){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		send_queue.push_back(buffer.str());
+	}
+	cv.notify_one();
+	buffer.str("");
+}
+
+void SolverProcess::run_writer(void){
+	while(true){
+		std::string data;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [this]{ return stopped or not send_queue.empty(); });
+			// 終了するときは残りを送らない(solverはもう終了させている)
+			if(stopped){
+				return;
+			}
+			data = std::move(send_queue.front());
+			send_queue.pop_front();
+		}
+		child.ostream() << data << std::flush;
+	}
+}
+
+void SolverProcess::run_reader(const int craftsman_num){
+	std::istream &is = child.istream();
+	while(Optional<SolverMessage> message = read_message(is, craftsman_num)){
+		if(not push(std::move(*message))){
+			return;
+		}
+	}
+}
+
+Optional<SolverMessage> SolverProcess::read_message(std::istream &is, const int craftsman_num){
+	SolverMessage message;
+	message.acts.resize(craftsman_num);
+	if(SOLVER_PROTOCOL == PROTOCOL::BINARY){
+		char type = read_frame_type(is);
+		while(is and type == 'N'){
+			push_insight(read_insight(is));
+			type = read_frame_type(is);
+		}
+		if(not is){
+			return none;
+		}
+		message.is_final = (type != 'Q');
+		if((type != 'A' and type != 'Q') or read_digits(is, 1) != craftsman_num){
+			// 何もしない行動として扱い、残りを読み飛ばして次のフレームから読む
+			Console << U"Invalid action frame from solver";
+			skip_frame(is);
+			return message;
+		}
+	}else{
+		is >> std::ws;
+		while(std::isalpha(is.peek())){
+			std::string word;
+			is >> word;
+			if(word == "insight"){
+				push_insight(read_insight(is));
+				is >> std::ws;
+				continue;
+			}
+			message.is_final = false;
+			break;
+		}
+	}
+	for(Craftsman &craftsman : message.acts){
+		craftsman.read_act(is);
+	}
+	if(not is){
+		return none;
+	}
+	return message;
+}
+
+SolverInsight SolverProcess::read_insight(std::istream &is){
+	SolverInsight insight;
+	if(SOLVER_PROTOCOL == PROTOCOL::BINARY){
+		insight.turn = read_digits(is, 2);
+		insight.elapsed_ms = read_digits(is, 3);
+		insight.limit_ms = read_digits(is, 3);
+		insight.sa_steps = read_digits(is, 4);
+		insight.best_cost = read_digits(is, 2);
+		insight.score = read_digits(is, 3) - PROTOCOL_SCORE_OFFSET;
+		insight.routes.resize(read_digits(is, 1));
+		for(Array<Point> &route : insight.routes){
+			route = read_points(is);
+		}
+		insight.territory = read_points(is);
+		return insight;
+	}
+	const auto read_text_points = [&is](Array<Point> &points){
+		size_t num = 0;
+		is >> num;
+		points.resize(num);
+		for(Point &p : points){
+			is >> p.y >> p.x;
+		}
+	};
+	size_t routes_num = 0;
+	is >> insight.turn >> insight.elapsed_ms >> insight.limit_ms >> insight.sa_steps >> insight.best_cost >> insight.score >> routes_num;
+	insight.routes.resize(routes_num);
+	for(Array<Point> &route : insight.routes){
+		read_text_points(route);
+	}
+	read_text_points(insight.territory);
+	return insight;
+}
@@ -0,0 +1,172 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include <deque>
+# include <mutex>
+# include <chrono>
+# include <thread>
+# include <functional>
+# include <condition_variable>
+# include "SolverIO.hpp"
+# include "../solver/solver_api.hpp"
+
+
+// solverをsolver.exeを起動せずに同じプロセスの別スレッドで動かす(SOLVER_LIBRARYを定義したときに使う)
+// ../solver/solver_lib.cppをプロジェクトに追加してビルドする. solverは盤面の大きさなどをグローバルに持つので同時に1つだけ
+class SolverLibrary : public SolverBackend {
+public:
+	SolverLibrary(void);
+	~SolverLibrary() override;
+	void initialize(const bool is_first, const int turn_num, const int time_ms, const Field &field) override;
+	void give_snapshot(const Array<Array<int>> &codes, const Array<Point> &changed, const Array<Point> &ally, const Array<Point> &enemy) override;
+	void give_acts(const Array<Craftsman> &acts) override;
+	void give_build_plan(const Array<Point> &walls) override;
+
+private:
+	// solverのスレッドで順に実行する
+	void post(std::function<void()> job);
+	void run(void);
+	// 自分のターンなら行動を決めて渡す(solverのスレッドで呼ぶ)
+	void think_if_my_turn(void);
+
+	SolverAPI::Solver solver;
+	// 1ターンの持ち時間(ms)
+	int time_ms = 0;
+	// give_build_planで一緒に渡す相手の行動
+	SolverAPI::Acts enemy_acts;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopped = false;
+	std::thread thread;
+};
+
+// 座標の列を{y, x}の列にする
+SolverAPI::Coords to_solver_coords(const Array<Point> &points){
+	SolverAPI::Coords res;
+	for(const Point p : points){
+		res.emplace_back(p.y, p.x);
+	}
+	return res;
+}
+
+// {y, x}の列を座標の列にする
+Array<Point> from_solver_coords(const SolverAPI::Coords &coords){
+	Array<Point> res;
+	for(const auto &[y, x] : coords){
+		res.emplace_back(x, y);
+	}
+	return res;
+}
+
+SolverLibrary::SolverLibrary(void){
+	thread = std::thread([this]{ run(); });
+}
+
+SolverLibrary::~SolverLibrary(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = true;
+	}
+	cv.notify_one();
+	// 考えている途中ならそのターンの期限まで待つ
+	receive_stopped = true;
+	thread.join();
+}
+
+void SolverLibrary::initialize(const bool is_first, const int turn_num, const int time_ms, const Field &field){
+	this->time_ms = time_ms;
+	SolverAPI::MapInfo map;
+	map.height = HEIGHT;
+	map.width = WIDTH;
+	map.first = is_first;
+	map.turns = turn_num;
+	map.turn_ms = time_ms;
+	map.ponds = to_solver_coords(field.get_ponds());
+	map.castles = to_solver_coords(field.get_castles());
+	map.ally = to_solver_coords(field.get_craftsmen(TEAM::RED));
+	map.enemy = to_solver_coords(field.get_craftsmen(TEAM::BLUE));
+	post([this, map]{
+		solver.init(map);
+		think_if_my_turn();
+	});
+}
+
+void SolverLibrary::give_snapshot(const Array<Array<int>> &codes, const Array<Point> &, const Array<Point> &ally, const Array<Point> &enemy){
+	SolverAPI::Board board;
+	for(const Array<int> &row : codes){
+		board.codes.insert(board.codes.end(), row.begin(), row.end());
+	}
+	board.ally = to_solver_coords(ally);
+	board.enemy = to_solver_coords(enemy);
+	post([this, board]{ solver.sync(board); });
+}
+
+void SolverLibrary::give_acts(const Array<Craftsman> &acts){
+	enemy_acts.clear();
+	for(const Craftsman &craftsman : acts){
+		enemy_acts.push_back({ craftsman.direction, (int)craftsman.act });
+	}
+}
+
+void SolverLibrary::give_build_plan(const Array<Point> &walls){
+	post([this, walls = to_solver_coords(walls), acts = enemy_acts]{
+		solver.set_build_plan(walls);
+		solver.on_enemy_actions(acts);
+		think_if_my_turn();
+	});
+}
+
+void SolverLibrary::post(std::function<void()> job){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	cv.notify_one();
+}
+
+void SolverLibrary::run(void){
+	while(true){
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [this]{ return stopped or not jobs.empty(); });
+			if(stopped){
+				return;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+	}
+}
+
+void SolverLibrary::think_if_my_turn(void){
+	if(solver.is_finished() or not solver.is_my_turn()){
+		return;
+	}
+	// solver.exeと同じく持ち時間の9割までに決める
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(time_ms * 9 / 10);
+	solver.think(deadline, [this](const SolverAPI::Acts &acts, const bool is_final){
+		SolverMessage message;
+		message.is_final = is_final;
+		message.acts.resize(acts.size());
+		for(size_t i = 0; i < acts.size(); i++){
+			message.acts[i].direction = acts[i].dir;
+			message.acts[i].act = (ACT)acts[i].type;
+		}
+		push(std::move(message));
+	}, [this](const SolverAPI::Insight &in){
+		SolverInsight insight;
+		insight.turn = in.turn;
+		insight.elapsed_ms = in.elapsed_ms;
+		insight.limit_ms = in.limit_ms;
+		insight.sa_steps = in.sa_steps;
+		insight.best_cost = in.best_cost;
+		insight.score = in.score;
+		for(const SolverAPI::Coords &route : in.routes){
+			insight.routes << from_solver_coords(route);
+		}
+		insight.territory = from_solver_coords(in.territory);
+		push_insight(std::move(insight));
+	});
+}
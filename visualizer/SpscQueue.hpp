@@ -0,0 +1,34 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include <array>
+# include <atomic>
+
+
+// 単一生産者・単一消費者のロックフリーなキュー(満杯ならpushは失敗する)
+template <class T, size_t N>
+class SpscQueue {
+public:
+	bool push(T &&value){
+		const size_t tail_now = tail.load(std::memory_order_relaxed);
+		if(tail_now - head.load(std::memory_order_acquire) == N){
+			return false;
+		}
+		buffer[tail_now % N] = std::move(value);
+		tail.store(tail_now + 1, std::memory_order_release);
+		return true;
+	}
+	Optional<T> pop(void){
+		const size_t head_now = head.load(std::memory_order_relaxed);
+		if(head_now == tail.load(std::memory_order_acquire)){
+			return none;
+		}
+		T value = std::move(buffer[head_now % N]);
+		head.store(head_now + 1, std::memory_order_release);
+		return value;
+	}
+
+private:
+	std::array<T, N> buffer;
+	std::atomic<size_t> head{ 0 };
+	std::atomic<size_t> tail{ 0 };
+};